@@ -0,0 +1,516 @@
+/*
+	benchmark.c v1.0
+	Benchmark for employee3.c, which generates a database file and times the database operations on it.
+	SOURCE CODE IS BEST VIEWED WITH A TAB WIDTH OF TWO
+*/
+
+#include <time.h>
+#include <fcntl.h>
+
+/* The database program is included directly (with its main() renamed), so that its functions can be timed one call at a time */
+#define main employee3_main
+#include "TYLERJ-employee3.c"
+#undef main
+
+/* Default number of records in the generated database file, and the limits on it */
+#define DEFAULT_RECORD_COUNT 100000
+#define MIN_RECORD_COUNT     1000
+#define MAX_RECORD_COUNT     10000000
+
+/* Default number of adds, searches and bulk deletes to time */
+#define DEFAULT_OPERATION_COUNT 10000
+
+/* Default name of the generated database file */
+#define DEFAULT_DATABASE_FILE "benchmark-database.txt"
+
+/* Codes for the distributions of names in the generated database file */
+#define SORTED_NAMES     0
+#define REVERSE_NAMES    1
+#define RANDOM_NAMES     2
+#define DUPLICATE_NAMES  3
+
+/* Array to store the names of the distributions, as they are typed on the command line.
+	 distribution_name[SORTED_NAMES] evaluates to a pointer to the string "sorted", RANDOM_NAMES a pointer to the string "random" etc. */
+const char distribution_name[4][11] = {"sorted","reverse","random","duplicate"};
+
+/* With the duplicate distribution, there is on average this many employees with each name */
+#define EMPLOYEES_PER_DUPLICATE_NAME 100
+
+/* Jobs given to the generated employees */
+const char *generated_job[8] = {"Engineer","Manager","Accountant","Cleaner","Salesperson","Receptionist","Driver","Technician"};
+
+/* Timing results for one operation */
+struct timing_struct
+{
+	const char *operation;   /* the name of the operation */
+	long count;              /* the number of operations (or records, for operations done as a single call) */
+	double total;            /* the total time taken (in seconds) */
+	double *latency;         /* the time taken by each call (in seconds), sorted, or NULL if the operation was done as a single call */
+	long calls;              /* the number of elements in latency */
+};
+
+/* Typedef structure as 'timing' to make it easier to use */
+typedef struct timing_struct timing;
+
+/* Prototypes for the functions */
+static double seconds_now(void);
+static unsigned long mix(unsigned long value);
+static void generate_name(char *name, long i, long record_count, int distribution);
+static void generate_employee(employee *employee_to_generate, long i, long record_count, int distribution);
+static void write_database_file(const char *file_name, long record_count, int distribution);
+static int compare_latencies(const void *first, const void *second);
+static double percentile(const timing *result, int percent);
+static void print_timing(const timing *result);
+static void time_load(timing *result, const char *file_name, long record_count);
+static void time_adds(timing *result, long operation_count, long record_count, int distribution);
+static void time_searches(timing *result, long operation_count, long record_count, int distribution);
+static void time_print(timing *result);
+static void time_bulk_delete(timing *result, long operation_count, long record_count, int distribution);
+
+/*
+	Function: main()
+	Purpose: Generate a database file, load it and time adding, searching for, printing and bulk deleting employees,
+					 then print the throughput and latency percentiles of each operation.
+	Arguments: Options, as printed by the usage message:
+						 -n <records>     number of records in the generated database file
+						 -o <operations>  number of adds, searches and bulk deletes to time
+						 -d <distribution> distribution of the names (sorted, reverse, random or duplicate)
+						 -f <file>        name of the generated database file
+						 -k               keep the generated database file, rather than deleting it afterwards
+						 -g               only generate the database file, without timing anything
+	Return value: EXIT_SUCCESS (0) or EXIT_FAILURE (1)
+	Inputs from user: None.
+	Outputs to user: The timing results (printed to stdout).
+									 Usage and error messages (printed to stderr).
+ */
+int main ( int argc, char *argv[] )
+{
+	long record_count = DEFAULT_RECORD_COUNT, operation_count = DEFAULT_OPERATION_COUNT;
+	int distribution = RANDOM_NAMES, keep_file = 0, generate_only = 0, option;
+	const char *file_name = DEFAULT_DATABASE_FILE;
+	timing results[5];
+	int i;
+
+	while((option = getopt(argc, argv, "n:o:d:f:kg")) != -1)
+	{
+		switch(option)
+		{
+			case 'n':
+			record_count = atol(optarg);
+			break;
+
+			case 'o':
+			operation_count = atol(optarg);
+			break;
+
+			case 'd':
+			for(distribution = 0; distribution < 4 && strcmp(optarg, distribution_name[distribution]) != 0; distribution++)
+				;
+			break;
+
+			case 'f':
+			file_name = optarg;
+			break;
+
+			case 'k':
+			keep_file = 1;
+			break;
+
+			case 'g':
+			generate_only = keep_file = 1;
+			break;
+
+			default:
+			distribution = -1;
+			break;
+		}
+	}
+
+	if(optind != argc || distribution < 0 || distribution >= 4 || record_count < MIN_RECORD_COUNT || record_count > MAX_RECORD_COUNT || operation_count < 1)
+	{
+		fprintf(stderr, "Usage: %s [-n <records>] [-o <operations>] [-d sorted|reverse|random|duplicate] [-f <file>] [-k] [-g]\n", argv[0]);
+		fprintf(stderr, "<records> must be from %d to %d, and <operations> at least 1.\n", MIN_RECORD_COUNT, MAX_RECORD_COUNT);
+		exit(EXIT_FAILURE);
+	}
+
+	/* The same buffering as employee3.c uses, so that printing is timed the same way */
+	setvbuf(stdout, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	write_database_file(file_name, record_count, distribution);
+	if(generate_only)
+		return EXIT_SUCCESS;
+
+	time_load(&results[0], file_name, record_count);
+	time_adds(&results[1], operation_count, record_count, distribution);
+	time_searches(&results[2], operation_count, record_count, distribution);
+	time_print(&results[3]);
+	time_bulk_delete(&results[4], operation_count, record_count, distribution);
+
+	if(!keep_file)
+		remove(file_name);
+
+	printf("%ld records, %s names, %ld operations\n\n", record_count, distribution_name[distribution], operation_count);
+	printf("%-12s %10s %10s %14s %10s %10s %10s %10s\n", "operation", "count", "total ms", "per second", "p50 us", "p90 us", "p99 us", "max us");
+	for(i = 0; i < 5; i++)
+	{
+		print_timing(&results[i]);
+		free(results[i].latency);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/*
+	Function: seconds_now()
+	Purpose: Read the monotonic clock, for timing operations.
+	Arguments: None.
+	Return value: The current time, in seconds.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static double seconds_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	Function: mix()
+	Purpose: Scramble a number, so that consecutive numbers give unrelated results.
+					 This is used instead of rand() so that the name of the i'th generated employee can be worked out again later.
+	Arguments: The number to scramble (value).
+	Return value: The scrambled number.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long mix(unsigned long value)
+{
+	value ^= value >> 16;
+	value *= 0x45d9f3bUL;
+	value ^= value >> 16;
+	value *= 0x45d9f3bUL;
+	value ^= value >> 16;
+	return value;
+}
+
+/*
+	Function: generate_name()
+	Purpose: Work out the name of the i'th generated employee.
+	Arguments: The string to store the name in (name).
+						 The number of the employee (i), which may be more than record_count for employees added after loading.
+						 The number of records in the generated database file (record_count).
+						 The distribution of the names (distribution), one of the distribution codes defined above.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void generate_name(char *name, long i, long record_count, int distribution)
+{
+	switch(distribution)
+	{
+		case SORTED_NAMES:
+		sprintf(name, "Employee %09ld", i);
+		break;
+
+		case REVERSE_NAMES:
+		sprintf(name, "Employee %09ld", 2 * MAX_RECORD_COUNT - i);
+		break;
+
+		case RANDOM_NAMES:
+		sprintf(name, "Employee %09lu", mix(i) % 1000000000UL);
+		break;
+
+		case DUPLICATE_NAMES:
+		default:
+		sprintf(name, "Employee %09lu", mix(i) % (record_count / EMPLOYEES_PER_DUPLICATE_NAME));
+		break;
+	}
+
+	return;
+}
+
+/*
+	Function: generate_employee()
+	Purpose: Fill in the details of the i'th generated employee.
+	Arguments: The employee structure to fill in (employee_to_generate), which must have come from allocate_employee().
+						 The number of the employee, the number of records and the distribution of the names (i, record_count and distribution),
+							as for generate_name().
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void generate_employee(employee *employee_to_generate, long i, long record_count, int distribution)
+{
+	unsigned long details = mix(i + 1);
+	char name[MAX_NAME_LENGTH + 1];
+
+	generate_name(name, i, record_count, distribution);
+	set_employee_strings(employee_to_generate, name, generated_job[(details >> 8) % 8]);
+	employee_to_generate->sex = details % 2 ? 'M' : 'F';
+	employee_to_generate->age = 18 + (details >> 1) % 50;
+	return;
+}
+
+/*
+	Function: write_database_file()
+	Purpose: Write a database file of generated employees, in the format read by read_employee_databases().
+	Arguments: The name of the file to write (file_name).
+						 The number of records to write (record_count).
+						 The distribution of the names (distribution), one of the distribution codes defined above.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr), and the fact that the program will terminate, if the file can't be written.
+ */
+static void write_database_file(const char *file_name, long record_count, int distribution)
+{
+	FILE *file_pointer;
+	employee *generated = allocate_employee();
+	long i;
+
+	file_pointer = fopen(file_name, "w");
+	if(file_pointer == NULL)
+		print_error("Error opening file to write the generated database to.\nThe program will now exit.\n", DO_EXIT);
+	setvbuf(file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	/* Each record is followed by a blank line, which end_of_file_test() expects */
+	for(i = 0; i < record_count; i++)
+	{
+		generate_employee(generated, i, record_count, distribution);
+		print_single_employee(file_pointer, generated);
+		fputc('\n', file_pointer);
+	}
+
+	if(fclose(file_pointer) != 0)
+		print_error("Error writing the generated database.\nThe program will now exit.\n", DO_EXIT);
+	free_employee(generated);
+
+	return;
+}
+
+/*
+	Function: compare_latencies()
+	Purpose: Compare two latencies for qsort(), so that they are sorted from fastest to slowest.
+	Arguments: Pointers to the two latencies to compare (first and second).
+	Return value: < 0 if the first latency is smaller, 0 if they are the same, > 0 if the first latency is bigger.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_latencies(const void *first, const void *second)
+{
+	double difference = *(const double *)first - *(const double *)second;
+	return (difference > 0) - (difference < 0);
+}
+
+/*
+	Function: percentile()
+	Purpose: Find a percentile of the latencies of an operation.
+	Arguments: The timing results for the operation (result), whose latencies must be sorted.
+						 The percentile to find (percent), 100 giving the slowest call.
+	Return value: The latency, in seconds.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static double percentile(const timing *result, int percent)
+{
+	long i = (result->calls * percent + 99) / 100 - 1;
+	return result->latency[i < 0 ? 0 : i];
+}
+
+/*
+	Function: print_timing()
+	Purpose: Print a line of the results table for an operation.
+					 Latency percentiles are only printed for operations that were timed one call at a time.
+	Arguments: The timing results for the operation (result).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The line of the table (printed to stdout).
+ */
+static void print_timing(const timing *result)
+{
+	printf("%-12s %10ld %10.1f %14.0f", result->operation, result->count, result->total * 1e3, result->count / result->total);
+	if(result->latency != NULL)
+		printf(" %10.2f %10.2f %10.2f %10.2f\n", percentile(result, 50) * 1e6, percentile(result, 90) * 1e6,
+					 percentile(result, 99) * 1e6, percentile(result, 100) * 1e6);
+	else
+		printf(" %10s %10s %10s %10s\n", "-", "-", "-", "-");
+	return;
+}
+
+/*
+	Function: time_load()
+	Purpose: Time loading the generated database file with read_employee_databases().
+	Arguments: The timing results to fill in (result).
+						 The name of the generated database file (file_name).
+						 The number of records in it (record_count).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void time_load(timing *result, const char *file_name, long record_count)
+{
+	double start = seconds_now();
+	read_employee_databases(&file_name, 1);
+
+	result->operation = "load";
+	result->count = record_count;
+	result->total = seconds_now() - start;
+	result->latency = NULL;
+	result->calls = 0;
+	return;
+}
+
+/*
+	Function: time_adds()
+	Purpose: Time adding generated employees (with new names from the same distribution) to the database one at a time, with place_employee().
+					 Each employee is allocated and generated before the clock is started, so only place_employee() is timed.
+	Arguments: The timing results to fill in (result).
+						 The number of employees to add (operation_count).
+						 The number of records in the generated database file, and the distribution of the names (record_count and distribution).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void time_adds(timing *result, long operation_count, long record_count, int distribution)
+{
+	employee *employee_to_add;
+	double start;
+	long i;
+
+	result->operation = "add";
+	result->count = result->calls = operation_count;
+	result->total = 0;
+	result->latency = (double *)malloc(operation_count * sizeof(double));
+	if(result->latency == NULL)
+		print_error("Problem allocating memory for the timing results.\nThe program will now exit.\n", DO_EXIT);
+
+	for(i = 0; i < operation_count; i++)
+	{
+		/* Only placing the employee is timed, not generating it */
+		employee_to_add = allocate_employee();
+		generate_employee(employee_to_add, record_count + i, record_count, distribution);
+		start = seconds_now();
+		place_employee(employee_to_add);
+		result->latency[i] = seconds_now() - start;
+		result->total += result->latency[i];
+	}
+
+	qsort(result->latency, operation_count, sizeof(double), compare_latencies);
+	return;
+}
+
+/*
+	Function: time_searches()
+	Purpose: Time searching for the names of randomly chosen employees from the generated database file, with search_for_employee().
+	Arguments: The timing results to fill in (result).
+						 The number of searches (operation_count).
+						 The number of records in the generated database file, and the distribution of the names (record_count and distribution).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr) if an employee that should be there isn't found.
+									 The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void time_searches(timing *result, long operation_count, long record_count, int distribution)
+{
+	char name[MAX_NAME_LENGTH + 1];
+	employee *found;
+	double start;
+	long i;
+
+	result->operation = "search";
+	result->count = result->calls = operation_count;
+	result->total = 0;
+	result->latency = (double *)malloc(operation_count * sizeof(double));
+	if(result->latency == NULL)
+		print_error("Problem allocating memory for the timing results.\nThe program will now exit.\n", DO_EXIT);
+
+	for(i = 0; i < operation_count; i++)
+	{
+		generate_name(name, rand() % record_count, record_count, distribution);
+		start = seconds_now();
+		found = search_for_employee(name);
+		result->latency[i] = seconds_now() - start;
+		result->total += result->latency[i];
+
+		if(found == NULL)
+			fprintf(stderr, "Employee %s was not found.\n", name);
+	}
+
+	qsort(result->latency, operation_count, sizeof(double), compare_latencies);
+	return;
+}
+
+/*
+	Function: time_print()
+	Purpose: Time printing the whole database with menu_print_database(), with stdout sent to /dev/null while it runs.
+	Arguments: The timing results to fill in (result).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void time_print(timing *result)
+{
+	int saved_stdout, null_file;
+	double start;
+
+	fflush(stdout);
+	saved_stdout = dup(STDOUT_FILENO);
+	null_file = open("/dev/null", O_WRONLY);
+	dup2(null_file, STDOUT_FILENO);
+
+	start = seconds_now();
+	menu_print_database();
+	fflush(stdout);
+
+	result->operation = "print";
+	result->count = employee_count;
+	result->total = seconds_now() - start;
+	result->latency = NULL;
+	result->calls = 0;
+
+	dup2(saved_stdout, STDOUT_FILENO);
+	close(saved_stdout);
+	close(null_file);
+	return;
+}
+
+/*
+	Function: time_bulk_delete()
+	Purpose: Time deleting the employees with a list of randomly chosen names from the generated database file,
+					 in a single pass with delete_employees_where().
+	Arguments: The timing results to fill in (result).
+						 The number of names in the list (operation_count).
+						 The number of records in the generated database file, and the distribution of the names (record_count and distribution).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void time_bulk_delete(timing *result, long operation_count, long record_count, int distribution)
+{
+	struct name_list_struct list;
+	double start;
+	long i;
+
+	list.names = (char (*)[MAX_NAME_LENGTH+1])malloc(operation_count * sizeof(*list.names));
+	list.matched = (char *)calloc(operation_count + 1, 1);
+	if(list.names == NULL || list.matched == NULL)
+		print_error("Problem allocating memory for the list of employees to delete.\nThe program will now exit.\n", DO_EXIT);
+	for(i = 0; i < operation_count; i++)
+		generate_name(list.names[i], rand() % record_count, record_count, distribution);
+	list.count = operation_count;
+	list.next = 0;
+
+	/* Sorting the names is part of the bulk delete (as in menu_delete_listed_employees()), so is timed */
+	start = seconds_now();
+	qsort(list.names, list.count, sizeof(*list.names), compare_names);
+
+	result->operation = "bulk delete";
+	result->count = delete_employees_where(name_is_in_list, &list);
+	result->total = seconds_now() - start;
+	result->latency = NULL;
+	result->calls = 0;
+
+	free(list.matched);
+	free(list.names);
+	return;
+}
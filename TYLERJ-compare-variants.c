@@ -0,0 +1,483 @@
+/*
+	compare-variants.c v1.0
+	Builds employee1.c, employee2.c and employee3.c, runs them on the same command streams,
+	checks that their output agrees and reports the time and memory each operation costs in each version.
+	SOURCE CODE IS BEST VIEWED WITH A TAB WIDTH OF TWO
+*/
+
+/* Needed for wait4() and mkdtemp() to be declared when compiling with -std=c99 */
+#define _DEFAULT_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+/* Default number of employees added by the command streams, and the limits on it.
+	 employee1.c and employee2.c walk the whole list for every add, so the default is kept small enough for them */
+#define DEFAULT_RECORD_COUNT 2000
+#define MIN_RECORD_COUNT     10
+#define MAX_RECORD_COUNT     1000000
+
+/* Default number of times each program is run on each command stream (the fastest run is used) */
+#define DEFAULT_REPEATS 3
+
+/* One employee in this many is deleted by the command streams that delete */
+#define DELETE_ONE_IN 10
+
+/* The menu codes that every version shares */
+#define ADD_CODE    0
+#define DELETE_CODE 1
+#define PRINT_CODE  2
+#define EXIT_CODE   3
+
+/* Maximum number of programs that can be compared */
+#define MAX_PROGRAMS 8
+
+/* Compiler used to build the programs if CC isn't set, and the maximum length of the path of a built program */
+#define DEFAULT_COMPILER "cc"
+#define MAX_PATH_LENGTH  256
+
+/* Codes for the command streams. Each stream adds one operation to the stream given for it in base_stream[],
+	 so the cost of that operation is the difference between the two */
+#define START_STREAM  0    /* just exit */
+#define ADD_STREAM    1    /* add the employees, then exit */
+#define PRINT_STREAM  2    /* add the employees, print the database, then exit */
+#define DELETE_STREAM 3    /* add the employees, delete some of them, then exit */
+#define CHECK_STREAM  4    /* add the employees, delete some of them, print the database, then exit (only used to compare outputs) */
+#define STREAM_COUNT  5
+
+/* The stream that each command stream's operation is measured against (START_STREAM is measured on its own).
+	 The delete stream doesn't print, so that the cost of printing fewer employees isn't taken off the cost of deleting */
+const int base_stream[STREAM_COUNT] = {START_STREAM, START_STREAM, ADD_STREAM, ADD_STREAM, DELETE_STREAM};
+
+/* Array to store the names of the operations that each command stream adds to its base stream */
+const char stream_operation[STREAM_COUNT][7] = {"start","add","print","delete","check"};
+
+/* Jobs given to the generated employees */
+const char *generated_job[8] = {"Engineer","Manager","Accountant","Cleaner","Salesperson","Receptionist","Driver","Technician"};
+
+/* Results of running one program on one command stream */
+struct run_struct
+{
+	double wall_time;     /* elapsed time (in seconds) */
+	double cpu_time;      /* user and system time (in seconds) */
+	long max_rss;         /* largest resident set size (in kilobytes) */
+	FILE *output;         /* what the program wrote to stdout */
+	int status;           /* the exit status, as returned by wait4() */
+};
+
+/* Typedef structure as 'run' to make it easier to use */
+typedef struct run_struct run;
+
+/* Prototypes for the functions */
+static double seconds_now(void);
+static unsigned long mix(unsigned long value);
+static FILE *write_command_stream(int stream, long record_count);
+static void build_program(const char *source, const char *program);
+static void run_program(const char *program, FILE *commands, run *result);
+static void run_fastest(const char *program, FILE *commands, int repeats, run *result);
+static int outputs_agree(FILE *first, FILE *second);
+static void print_costs(const char *source, const run results[], int deletes, long record_count);
+static int group_outputs(run results[][STREAM_COUNT], const int deletes[], int program_count, int stream, char group[]);
+
+/*
+	Function: main()
+	Purpose: Build each source file given, run the programs on each command stream, then print a table of the cost of each operation
+					 per program, and which programs' outputs agree.
+	Arguments: Optionally -n <records>, the number of employees the command streams add.
+						 Optionally -r <repeats>, the number of times each program is run on each command stream.
+						 The source files of the programs to compare (e.g. TYLERJ-employee1.c TYLERJ-employee2.c TYLERJ-employee3.c).
+	Return value: EXIT_SUCCESS (0), or EXIT_FAILURE (1) if the arguments are wrong or a program can't be built or run.
+	Inputs from user: None.
+	Outputs to user: The results (printed to stdout).
+									 Usage and error messages (printed to stderr).
+ */
+int main ( int argc, char *argv[] )
+{
+	long record_count = DEFAULT_RECORD_COUNT;
+	int repeats = DEFAULT_REPEATS, program_count, option, stream, i;
+	int deletes[MAX_PROGRAMS], group_count, delete_group_count;
+	char print_group[MAX_PROGRAMS], delete_group[MAX_PROGRAMS];
+	char build_directory[] = "/tmp/compare-variants-XXXXXX";
+	char programs[MAX_PROGRAMS][MAX_PATH_LENGTH];
+	FILE *commands[STREAM_COUNT];
+	run results[MAX_PROGRAMS][STREAM_COUNT];
+
+	while((option = getopt(argc, argv, "n:r:")) != -1)
+	{
+		if(option == 'n')
+			record_count = atol(optarg);
+		else if(option == 'r')
+			repeats = atoi(optarg);
+		else
+			record_count = -1;
+	}
+
+	program_count = argc - optind;
+	if(program_count < 1 || program_count > MAX_PROGRAMS || record_count < MIN_RECORD_COUNT || record_count > MAX_RECORD_COUNT || repeats < 1)
+	{
+		fprintf(stderr, "Usage: %s [-n <records>] [-r <repeats>] <source file> [<source file> ...]\n", argv[0]);
+		fprintf(stderr, "<records> must be from %d to %d, <repeats> at least 1, and up to %d programs can be compared.\n",
+						MIN_RECORD_COUNT, MAX_RECORD_COUNT, MAX_PROGRAMS);
+		exit(EXIT_FAILURE);
+	}
+
+	/* Each program is built into its own file in a temporary directory, which is removed at the end */
+	if(mkdtemp(build_directory) == NULL)
+	{
+		fputs("Error creating a temporary directory to build the programs in.\nThe program will now exit.\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	for(i = 0; i < program_count; i++)
+	{
+		snprintf(programs[i], MAX_PATH_LENGTH, "%s/variant%d", build_directory, i + 1);
+		build_program(argv[optind + i], programs[i]);
+	}
+
+	for(stream = 0; stream < STREAM_COUNT; stream++)
+		commands[stream] = write_command_stream(stream, record_count);
+
+	for(i = 0; i < program_count; i++)
+	{
+		for(stream = 0; stream < STREAM_COUNT; stream++)
+			run_fastest(programs[i], commands[stream], repeats, &results[i][stream]);
+
+		/* A program whose print after deleting matches its print without deleting doesn't implement deleting */
+		deletes[i] = !outputs_agree(results[i][PRINT_STREAM].output, results[i][CHECK_STREAM].output);
+	}
+
+	printf("%ld employees added, 1 in %d deleted, fastest of %d runs\n\n", record_count, DELETE_ONE_IN, repeats);
+	printf("%-24s %-8s %12s %12s %12s\n", "program", "operation", "wall us/op", "cpu us/op", "rss bytes/op");
+	for(i = 0; i < program_count; i++)
+		print_costs(argv[optind + i], results[i], deletes[i], record_count);
+
+	/* Every pair of programs is compared, on the streams that print */
+	group_count = group_outputs(results, deletes, program_count, PRINT_STREAM, print_group);
+	delete_group_count = group_outputs(results, deletes, program_count, CHECK_STREAM, delete_group);
+	printf("\n%-24s %-10s %-10s\n", "output group", stream_operation[PRINT_STREAM], stream_operation[DELETE_STREAM]);
+	for(i = 0; i < program_count; i++)
+	{
+		if(delete_group[i] == 0)
+			printf("%-24s %-10c %-10s\n", argv[optind + i], print_group[i], "n/a");
+		else
+			printf("%-24s %-10c %-10c\n", argv[optind + i], print_group[i], delete_group[i]);
+	}
+	if(group_count > 1 || delete_group_count > 1)
+		puts("\nThe outputs are DIFFERENT: programs in different groups printed different things.");
+	else
+		puts("\nThe outputs agree.");
+
+	for(i = 0; i < program_count; i++)
+	{
+		for(stream = 0; stream < STREAM_COUNT; stream++)
+			fclose(results[i][stream].output);
+		unlink(programs[i]);
+	}
+	for(stream = 0; stream < STREAM_COUNT; stream++)
+		fclose(commands[stream]);
+	rmdir(build_directory);
+
+	return EXIT_SUCCESS;
+}
+
+/*
+	Function: seconds_now()
+	Purpose: Read the monotonic clock, for timing the programs.
+	Arguments: None.
+	Return value: The current time, in seconds.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static double seconds_now(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+	Function: mix()
+	Purpose: Scramble a number, so that consecutive numbers give unrelated results (used for the generated names and details).
+	Arguments: The number to scramble (value).
+	Return value: The scrambled number.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long mix(unsigned long value)
+{
+	value ^= value >> 16;
+	value *= 0x45d9f3bUL;
+	value ^= value >> 16;
+	value *= 0x45d9f3bUL;
+	value ^= value >> 16;
+	return value;
+}
+
+/*
+	Function: write_command_stream()
+	Purpose: Write the menu choices and answers to the prompts for one of the command streams to a temporary file.
+					 The employees are given names in a random order, with each name used once, so that every version should print them in the same order.
+	Arguments: The command stream to write (stream), one of the stream codes defined above.
+						 The number of employees to add (record_count).
+	Return value: The temporary file.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr), and the fact that the program will terminate, if the file can't be written.
+ */
+static FILE *write_command_stream(int stream, long record_count)
+{
+	FILE *file_pointer = tmpfile();
+	unsigned long details;
+	long i;
+
+	if(file_pointer == NULL)
+	{
+		fputs("Error creating a temporary file for a command stream.\nThe program will now exit.\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	if(stream != START_STREAM)
+		for(i = 0; i < record_count; i++)
+		{
+			details = mix(i + 1);
+			fprintf(file_pointer, "%d\nEmployee %09lu-%ld\n%c\n%lu\n%s\n", ADD_CODE, mix(i) % 1000000000UL, i,
+							details % 2 ? 'M' : 'F', 18 + (details >> 1) % 50, generated_job[(details >> 8) % 8]);
+		}
+
+	if(stream == DELETE_STREAM || stream == CHECK_STREAM)
+		for(i = 0; i < record_count; i += DELETE_ONE_IN)
+			fprintf(file_pointer, "%d\nEmployee %09lu-%ld\n", DELETE_CODE, mix(i) % 1000000000UL, i);
+
+	if(stream == PRINT_STREAM || stream == CHECK_STREAM)
+		fprintf(file_pointer, "%d\n", PRINT_CODE);
+
+	fprintf(file_pointer, "%d\n", EXIT_CODE);
+
+	if(fflush(file_pointer) != 0)
+	{
+		fputs("Error writing a command stream.\nThe program will now exit.\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+
+	return file_pointer;
+}
+
+/*
+	Function: build_program()
+	Purpose: Compile a source file with the compiler named by the CC environment variable (or cc if it isn't set).
+	Arguments: The source file (source).
+						 The path to write the program to (program).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The compiler's messages (printed to stderr).
+									 An error message, and the fact that the program will terminate, if the source file can't be built.
+ */
+static void build_program(const char *source, const char *program)
+{
+	const char *compiler = getenv("CC");
+	pid_t child;
+	int status;
+
+	if(compiler == NULL || compiler[0] == '\0')
+		compiler = DEFAULT_COMPILER;
+
+	child = fork();
+	if(child == 0)
+	{
+		execlp(compiler, compiler, "-O2", "-pthread", "-o", program, source, (char *)NULL);
+		_exit(127);
+	}
+	if(child < 0 || waitpid(child, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		fprintf(stderr, "Error building %s with %s.\nThe program will now exit.\n", source, compiler);
+		exit(EXIT_FAILURE);
+	}
+
+	return;
+}
+
+/*
+	Function: run_program()
+	Purpose: Run a program with a command stream as its stdin, saving its stdout to a temporary file (its prompts on stderr are thrown away),
+					 and measure how long it takes and how much memory it uses.
+	Arguments: The program to run (program).
+						 The command stream (commands).
+						 The results to fill in (result).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr) if the program doesn't exit successfully.
+									 An error message, and the fact that the program will terminate, if the program can't be started.
+ */
+static void run_program(const char *program, FILE *commands, run *result)
+{
+	struct rusage usage;
+	pid_t child;
+	double start;
+	int null_file;
+
+	result->output = tmpfile();
+	if(result->output == NULL)
+	{
+		fputs("Error creating a temporary file for a program's output.\nThe program will now exit.\n", stderr);
+		exit(EXIT_FAILURE);
+	}
+	rewind(commands);
+
+	start = seconds_now();
+	child = fork();
+	if(child == 0)
+	{
+		null_file = open("/dev/null", O_WRONLY);
+		dup2(fileno(commands), STDIN_FILENO);
+		dup2(fileno(result->output), STDOUT_FILENO);
+		dup2(null_file, STDERR_FILENO);
+		execl(program, program, (char *)NULL);
+		_exit(127);
+	}
+	if(child < 0 || wait4(child, &result->status, 0, &usage) < 0)
+	{
+		fprintf(stderr, "Error running %s.\nThe program will now exit.\n", program);
+		exit(EXIT_FAILURE);
+	}
+
+	result->wall_time = seconds_now() - start;
+	result->cpu_time = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+	result->max_rss = usage.ru_maxrss;
+
+	if(!WIFEXITED(result->status) || WEXITSTATUS(result->status) != 0)
+		fprintf(stderr, "%s did not exit successfully (status %d).\n", program, result->status);
+
+	return;
+}
+
+/*
+	Function: run_fastest()
+	Purpose: Run a program on a command stream a number of times with run_program(), and keep the results of the fastest run,
+					 so that the costs worked out from the difference between two streams aren't thrown off by one slow run.
+	Arguments: The program to run (program).
+						 The command stream (commands).
+						 The number of times to run the program (repeats).
+						 The results to fill in (result).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: As for run_program().
+ */
+static void run_fastest(const char *program, FILE *commands, int repeats, run *result)
+{
+	run next_run;
+
+	run_program(program, commands, result);
+	while(--repeats > 0)
+	{
+		run_program(program, commands, &next_run);
+		if(next_run.wall_time < result->wall_time)
+		{
+			fclose(result->output);
+			*result = next_run;
+		}
+		else
+			fclose(next_run.output);
+	}
+
+	return;
+}
+
+/*
+	Function: outputs_agree()
+	Purpose: Compare the output of two programs.
+	Arguments: The temporary files holding the two outputs (first and second).
+	Return value: 1 if the outputs are the same.
+								0 if they are not.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int outputs_agree(FILE *first, FILE *second)
+{
+	int c;
+
+	rewind(first);
+	rewind(second);
+	while((c = getc(first)) == getc(second))
+		if(c == EOF)
+			return 1;
+
+	return 0;
+}
+
+/*
+	Function: print_costs()
+	Purpose: Print the cost of each operation for one program. The cost of an operation is the difference between the stream that
+					 does it and its base stream, divided by the number of times the operation is done (once for start and print).
+	Arguments: The source file of the program (source).
+						 The results of running it on each command stream (results).
+						 Whether the program implements deleting (deletes), as the delete cost is printed as n/a if it doesn't.
+						 The number of employees the command streams add (record_count).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The lines of the table (printed to stdout).
+ */
+static void print_costs(const char *source, const run results[], int deletes, long record_count)
+{
+	long operations[STREAM_COUNT];
+	int stream;
+
+	operations[START_STREAM] = 1;
+	operations[ADD_STREAM] = record_count;
+	operations[PRINT_STREAM] = 1;
+	operations[DELETE_STREAM] = (record_count + DELETE_ONE_IN - 1) / DELETE_ONE_IN;
+
+	printf("%-24s %-8s %12.2f %12.2f %12s\n", source, stream_operation[START_STREAM],
+				 results[START_STREAM].wall_time * 1e6, results[START_STREAM].cpu_time * 1e6, "-");
+	for(stream = ADD_STREAM; stream <= DELETE_STREAM; stream++)
+	{
+		if(stream == DELETE_STREAM && !deletes)
+			printf("%-24s %-8s %12s %12s %12s\n", source, stream_operation[stream], "n/a", "n/a", "n/a");
+		else
+			printf("%-24s %-8s %12.2f %12.2f %12.1f\n", source, stream_operation[stream],
+						 (results[stream].wall_time - results[base_stream[stream]].wall_time) * 1e6 / operations[stream],
+						 (results[stream].cpu_time - results[base_stream[stream]].cpu_time) * 1e6 / operations[stream],
+						 (results[stream].max_rss - results[base_stream[stream]].max_rss) * 1024.0 / operations[stream]);
+	}
+
+	return;
+}
+
+/*
+	Function: group_outputs()
+	Purpose: Compare the output of every pair of programs on one command stream, and put programs that printed exactly the same thing
+					 in the same group (A, B and so on), so if every program is in group A they all agree.
+					 Programs that don't implement deleting aren't put in a group for the stream that deletes, rather than being compared.
+	Arguments: The results of running each program on each command stream (results).
+						 Whether each program implements deleting (deletes).
+						 The number of programs (program_count).
+						 The command stream to compare (stream), PRINT_STREAM or CHECK_STREAM.
+						 The array to fill in with each program's group, or 0 if it isn't in one (group).
+	Return value: The number of groups.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int group_outputs(run results[][STREAM_COUNT], const int deletes[], int program_count, int stream, char group[])
+{
+	int group_count = 0, i, j;
+
+	for(i = 0; i < program_count; i++)
+	{
+		group[i] = 0;
+		if(stream == CHECK_STREAM && !deletes[i])
+			continue;
+
+		for(j = 0; j < i && group[i] == 0; j++)
+			if(group[j] != 0 && outputs_agree(results[i][stream].output, results[j][stream].output))
+				group[i] = group[j];
+		if(group[i] == 0)
+			group[i] = 'A' + group_count++;
+	}
+
+	return group_count;
+}
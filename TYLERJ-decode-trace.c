@@ -0,0 +1,85 @@
+/*
+	decode-trace.c v1.0
+	Prints the events in a trace file written by employee3.c, one per line, oldest first.
+	SOURCE CODE IS BEST VIEWED WITH A TAB WIDTH OF TWO
+*/
+
+/* The database program is included directly (with its main() renamed), so that the trace file is read with the same structures it was written with */
+#define main employee3_main
+#include "TYLERJ-employee3.c"
+#undef main
+
+/* Prototypes for the functions */
+static void print_trace_event(const trace_event *event);
+
+/*
+	Function: main()
+	Purpose: Read a trace file and print each event in it.
+	Arguments: The name of the trace file (argv[1]), which defaults to the name employee3.c uses when EMPLOYEE_TRACE isn't set.
+	Return value: EXIT_SUCCESS (0) or EXIT_FAILURE (1)
+	Inputs from user: None.
+	Outputs to user: The events (printed to stdout).
+									 Usage and error messages (printed to stderr).
+ */
+int main ( int argc, char *argv[] )
+{
+	const char *file_name = argc == 2 ? argv[1] : DEFAULT_TRACE_FILE;
+	FILE *file_pointer;
+	trace_file_header header;
+	trace_event event;
+	unsigned long long i;
+
+	if(argc > 2)
+	{
+		fprintf(stderr, "Usage: %s [<trace-file>]\n", argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	file_pointer = fopen(file_name, "rb");
+	if(file_pointer == NULL)
+		print_error("Error opening trace file.\nThe program will now exit.\n", DO_EXIT);
+
+	if(fread(&header, sizeof(header), 1, file_pointer) != 1 || memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0)
+		print_error("This is not a trace file.\nThe program will now exit.\n", DO_EXIT);
+	if(header.event_size != sizeof(trace_event))
+		print_error("This trace file was written by a differently built program.\nThe program will now exit.\n", DO_EXIT);
+
+	printf("%llu events recorded, %llu in the file", header.recorded, header.saved);
+	if(header.recorded > header.saved)
+		printf(" (the oldest %llu were overwritten)", header.recorded - header.saved);
+	printf("\n\n%14s  %-16s %18s %18s %18s  %s\n", "time us", "event", "employee", "before", "after", "value");
+
+	for(i = 0; i < header.saved; i++)
+	{
+		if(fread(&event, sizeof(event), 1, file_pointer) != 1)
+			print_error("The trace file is shorter than its header says.\nThe program will now exit.\n", DO_EXIT);
+		print_trace_event(&event);
+	}
+
+	fclose(file_pointer);
+	return EXIT_SUCCESS;
+}
+
+/*
+	Function: print_trace_event()
+	Purpose: Print a single trace event, with the time in microseconds, the type of event by name, the employee addresses in hex,
+					 and the value (as a character as well as a number, for events whose value is a character).
+	Arguments: The event to print (event).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The event (printed to stdout).
+ */
+static void print_trace_event(const trace_event *event)
+{
+	printf("%14.3f  %-16s %#18llx %#18llx %#18llx  %d", event->time / 1e3,
+				 event->type >= 0 && event->type < TRACE_EVENT_TYPES ? trace_event_name[event->type] : "unknown",
+				 event->employee, event->before, event->after, event->value);
+
+	if((event->type == TRACE_PREFIX_MISMATCH || event->type == TRACE_END_OF_FILE_TEST) && isprint(event->value))
+		printf(" '%c'", event->value);
+	else if((event->type == TRACE_PREFIX_MISMATCH || event->type == TRACE_END_OF_FILE_TEST) && event->value == '\n')
+		printf(" '\\n'");
+	putchar('\n');
+
+	return;
+}
@@ -8,14 +8,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
 
-/* Uncomment any of these lines to debug the respective sections */
-/* #define DEBUG_READ_LINE */
-/* #define DEBUG_READ_STRING */
-/* #define DEBUG_PLACE_EMPLOYEE */
-/* #define DEBUG_SEARCH_FOR_EMPLOYEE */
-/* #define DEBUG_DELETE_EMPLOYEE */
-/* #define DEBUG_END_OF_FILE_TEST */
+/* To debug the program, turn tracing on (see trace_event_add()) rather than recompiling it.
+	 Tracing can be turned on from the start by setting the environment variable EMPLOYEE_TRACE to the name of the file to write the trace to,
+	 or turned on and off from the menu. The trace is read with TYLERJ-decode-trace.c. */
 
 /* Maximum length (in characters) that the respective structure members (which are strings) can be */
 #define MAX_NAME_LENGTH 100
@@ -25,17 +27,37 @@
 	 for the structure members that aren't stored as strings */
 #define MAX_CHARS_TO_READ 300
 
+/* The size of the buffer used when reading or writing the database file */
+#define DATABASE_FILE_BUFFER_SIZE 65536
+
+/* Maximum length (in characters) of a file name typed in by the user */
+#define MAX_FILE_NAME_LENGTH 300
+
 /* Employee structure */
 struct employee_struct
 {
-	/* Employee details */
-	char name[MAX_NAME_LENGTH+1]; /* name string */
+	/* Employee details.
+		 The name and job strings are kept together in a single allocation that is just big enough for them (see set_employee_strings()),
+		 rather than in arrays of MAX_NAME_LENGTH and MAX_JOB_LENGTH characters, most of which would be unused */
+	char *name;                   /* name string */
 	char sex;                     /* sex identifier, either 'M' or 'F' */
 	int  age;                     /* age */
-	char job[MAX_JOB_LENGTH+1];   /* job string */
+	char *job;                    /* job string (directly after the name string, in the same allocation) */
    
 	/* pointers to previous and next employee structures in the linked list */
 	struct employee_struct *prev, *next;
+
+	/* Number that identifies the employee. Employees with the same name are in the linked list in descending order of id,
+		 which lets a cursor (see cursor_struct) mark a position between employees with the same name */
+	unsigned long id;
+
+	/* Name index details */
+	unsigned long name_hash;              /* hash of the name string, used to pick the name index bucket */
+	struct employee_struct *bucket_next;  /* pointer to the next employee structure in the same name index bucket */
+
+	/* Skip list details */
+	int skip_levels;                      /* number of skip list levels this employee is on (always at least 1, level 0 being the linked list itself) */
+	struct employee_struct **skip_next;   /* pointers to the next employee structure on levels 1 to skip_levels-1 (NULL if skip_levels is 1) */
 };
 
 /* Typedef structure as 'employee' to make it easier to use */
@@ -44,6 +66,56 @@ typedef struct employee_struct employee;
 /* Head pointer for linked list */
 employee *head = NULL;
 
+/* The id to give to the next employee added to the linked list */
+unsigned long next_employee_id = 0;
+
+/* The name of the database file that was loaded (NULL if the program was started with an empty database, or with several database files) */
+const char *database_file_name = NULL;
+
+/* Number of buckets in the name index.
+	 Employees are partitioned between the buckets by a hash of their name, so that operations on a single name
+	 (e.g. searching and deleting) only have to look at the employees in one bucket, rather than walking the whole linked list. */
+#define NAME_INDEX_BUCKETS 4096
+
+/* The name index, each element is the head of a (singly) linked list of the employees whose name hashes to that bucket */
+employee *name_index[NAME_INDEX_BUCKETS];
+
+/* Size of the Bloom filter over the names in the database (in blocks, and counters in each block), and the number of counters each name uses.
+	 search_for_employee() checks the filter before walking a bucket of the name index, so most names that aren't in the database
+	 are rejected without looking at any employees. All the counters a name uses are in the same block, which is the size of a cache line.
+	 The counters are counts of employees, so that an employee can be taken out of the filter when it is deleted,
+	 except that a counter that reaches BLOOM_FILTER_MAX_COUNT stays there (as the real count is no longer known). */
+#define BLOOM_FILTER_BLOCKS     65536
+#define BLOOM_FILTER_BLOCK_SIZE 64
+#define BLOOM_FILTER_HASHES     4
+#define BLOOM_FILTER_MAX_COUNT  255
+
+/* The Bloom filter counters */
+unsigned char bloom_filter[BLOOM_FILTER_BLOCKS][BLOOM_FILTER_BLOCK_SIZE];
+
+/* Maximum number of levels in the skip list, and the chance (1 in SKIP_LIST_CHANCE) of an employee being put on each level above the first.
+	 The skip list is built on top of the linked list (which is level 0), and lets place_employee() find where an employee belongs
+	 by skipping over many employees at a time on the higher levels, rather than walking the whole list. */
+#define SKIP_LIST_MAX_LEVELS 16
+#define SKIP_LIST_CHANCE     4
+
+/* Head pointers for levels 1 and above of the skip list (skip_list_head[0] is not used, as level 0 starts at head) */
+employee *skip_list_head[SKIP_LIST_MAX_LEVELS];
+
+/* The number of skip list levels currently in use */
+int skip_list_levels = 1;
+
+/* Number of employee structures to allocate at once.
+	 Employee structures are taken from blocks of this size rather than calling malloc() for every employee,
+	 and deleted employees are kept on a free list so that their memory can be reused by the next employee added. */
+#define EMPLOYEES_PER_BLOCK 256
+
+/* Head pointer for the list of free employee structures (linked through their next pointers) */
+employee *free_employees = NULL;
+
+/* Number of blocks of employee structures allocated so far (blocks are never freed) */
+unsigned long employee_blocks = 0;
+
 /* Global constants to make the use of the following arrays more intuitive */
 #define PREFIX_OFF 0
 #define PREFIX_ON 1
@@ -76,53 +148,559 @@ const char *file_read_failure = "Failed to read database file, please ensure tha
 #define INPUT_FROM_USER 0
 #define INPUT_FROM_FILE 1
 
+/* Maximum number of conditions (joined by AND) in a query */
+#define MAX_QUERY_CONDITIONS 8
+
+/* Codes for the comparison operators that can be used in a query condition */
+#define EQUAL_TO                 0
+#define NOT_EQUAL_TO             1
+#define LESS_THAN                2
+#define LESS_THAN_OR_EQUAL_TO    3
+#define GREATER_THAN             4
+#define GREATER_THAN_OR_EQUAL_TO 5
+
+/* Array to store the comparison operators as they are typed in a query.
+	 comparison_operator[EQUAL_TO] evaluates to a pointer to the string "=", LESS_THAN_OR_EQUAL_TO a pointer to the string "<=" etc. */
+const char comparison_operator[6][3] = {"=","!=","<","<=",">",">="};
+
+/* Array to store how long it takes to test a condition on each structure member, relative to the others.
+	 Conditions on sex and age (which are single numbers) are tested before conditions on name and job (which are strings),
+	 so that employees can be rejected as quickly as possible. */
+const int condition_cost[4] = {2,0,1,3};
+
+/* Query condition structure, e.g. for "age >= 30" */
+struct condition_struct
+{
+	int  field_identifier;               /* the structure member to test (uses the constants for structure members defined previously) */
+	int  comparison;                     /* the comparison operator (uses the constants for comparison operators) */
+	int  number;                         /* the value to compare with, for the sex and age members */
+	char text[MAX_CHARS_TO_READ+1];      /* the value to compare with, for the name and job members */
+};
+
+/* Typedef structure as 'condition' to make it easier to use */
+typedef struct condition_struct condition;
+
+/* Compiled query structure, created from the text of a query by compile_query() */
+struct query_struct
+{
+	int condition_count;                           /* the number of conditions, which must all be true for an employee to match */
+	condition conditions[MAX_QUERY_CONDITIONS];    /* the conditions, in the order they should be tested */
+
+	/* The range of names that matching employees can be in, worked out from any conditions on the name.
+		 Only employees in this range are looked at, rather than the whole linked list. */
+	const char *name_from;                         /* the first name in the range (NULL for the start of the list) */
+	const char *name_to;                           /* the last name in the range (NULL for the end of the list) */
+	int name_to_inclusive;                         /* whether the name_to is included in the range */
+	int use_name_index;                            /* whether the range is a single name, in which case it is found with the name index */
+};
+
+/* Typedef structure as 'query' to make it easier to use */
+typedef struct query_struct query;
+
+/* Number of query results that are remembered, and the most employees that can be remembered for a single query */
+#define QUERY_CACHE_ENTRIES     16
+#define QUERY_CACHE_MAX_RESULTS 10000
+
+/* Query cache entry structure, remembering the employees that matched a query so that they don't have to be searched for again.
+	 An entry is thrown away whenever an employee that matches its conditions is added or deleted, as that changes the result. */
+struct query_cache_entry_struct
+{
+	int in_use;                                    /* whether the entry holds a result */
+	unsigned long last_used;                       /* when the entry was last used, for choosing which entry to reuse */
+	int condition_count;                           /* the number of conditions in the query */
+	condition conditions[MAX_QUERY_CONDITIONS];    /* the conditions in the query, in the order left by compile_query() */
+	int result_count;                              /* the number of employees that matched */
+	struct employee_struct **results;              /* pointers to the employees that matched, in alphabetical order */
+};
+
+/* Typedef structure as 'query_cache_entry' to make it easier to use */
+typedef struct query_cache_entry_struct query_cache_entry;
+
+/* The query cache, and a counter used to record when each entry was last used */
+query_cache_entry query_cache[QUERY_CACHE_ENTRIES];
+unsigned long query_cache_clock = 0;
+
+/* Number of buckets in the hash table used to group employees by job and sex for the job report */
+#define JOB_GROUP_BUCKETS 1024
+
+/* The value used in place of the sex for a group containing all the employees with a job, whatever their sex */
+#define ALL_SEXES '*'
+
+/* Job group structure, holding the figures for the job report for all the employees with a job and sex */
+struct job_group_struct
+{
+	char job[MAX_JOB_LENGTH+1];           /* job string */
+	char sex;                             /* sex identifier, either 'M', 'F' or ALL_SEXES */
+	int  count;                           /* number of employees in the group */
+	int  min_age, max_age;                /* youngest and oldest ages in the group */
+	double total_age;                     /* sum of the ages in the group, for working out the average */
+	int  ages_stale;                      /* whether min_age and max_age need working out again, after the youngest or oldest employee was deleted */
+
+	/* pointer to the next job group structure in the same hash table bucket */
+	struct job_group_struct *bucket_next;
+};
+
+/* Typedef structure as 'job_group' to make it easier to use */
+typedef struct job_group_struct job_group;
+
+/* Ranked employee structure, used when sorting employees by age.
+	 The position of the employee in the linked list is kept so that employees with the same age stay in alphabetical order. */
+struct ranked_employee_struct
+{
+	employee *record;                     /* pointer to the employee (the employee structure itself is never copied) */
+	int position;                         /* position of the employee in the linked list */
+};
+
+/* Typedef structure as 'ranked_employee' to make it easier to use */
+typedef struct ranked_employee_struct ranked_employee;
+
+/* Default number of employees on each page when printing the database a page at a time */
+#define DEFAULT_PAGE_SIZE 50
+
+/* Cursor structure, marking a position in the alphabetical order of the database that printing can be carried on from.
+	 The position is directly after the employee with the given name and id, so it stays valid even if that employee is deleted. */
+struct cursor_struct
+{
+	char name[MAX_NAME_LENGTH+1];         /* name of the employee the cursor is after */
+	unsigned long id;                     /* id of the employee the cursor is after (ULONG_MAX to be before every employee with the name) */
+};
+
+/* Typedef structure as 'cursor' to make it easier to use */
+typedef struct cursor_struct cursor;
+
+/* Queries that have to look at every employee are run on several threads at once, if the database has at least PARALLEL_SCAN_MIN_EMPLOYEES employees.
+	 The linked list is split into contiguous partitions, PARTITIONS_PER_THREAD for each thread (up to MAX_SCAN_THREADS threads),
+	 and each thread takes the next partition that hasn't been scanned as soon as it finishes one, so that no thread sits idle while others have work left. */
+#define PARALLEL_SCAN_MIN_EMPLOYEES 50000
+#define PARTITIONS_PER_THREAD       4
+#define MAX_SCAN_THREADS            32
+
+/* Codes for what a parallel scan collects from the matching employees */
+#define SCAN_FOR_RESULTS    0
+#define SCAN_FOR_JOB_GROUPS 1
+
+/* Scan partition structure, holding one contiguous part of the linked list and what was collected from it */
+struct scan_partition_struct
+{
+	struct employee_struct *first;                /* first employee in the partition */
+	struct employee_struct *end;                  /* employee after the last employee in the partition (NULL for the end of the list) */
+	struct employee_struct **results;             /* pointers to the matching employees, in alphabetical order (for SCAN_FOR_RESULTS) */
+	int result_count, result_space;               /* number of matching employees, and the number there is room for in results */
+	job_group *groups[JOB_GROUP_BUCKETS];         /* job groups of the matching employees (for SCAN_FOR_JOB_GROUPS) */
+	int group_count;                              /* number of job groups */
+};
+
+/* Typedef structure as 'scan_partition' to make it easier to use */
+typedef struct scan_partition_struct scan_partition;
+
+/* Parallel scan structure, shared by all the threads running a scan */
+struct parallel_scan_struct
+{
+	const query *compiled_query;                  /* the query that employees must match */
+	int scan_type;                                /* what to collect (uses the constants for scan types) */
+	scan_partition *partitions;                   /* the partitions, in alphabetical order */
+	int partition_count;                          /* the number of partitions */
+	int next_partition;                           /* the next partition for a thread to take */
+	pthread_mutex_t lock;                         /* lock protecting next_partition */
+};
+
+/* Typedef structure as 'parallel_scan' to make it easier to use */
+typedef struct parallel_scan_struct parallel_scan;
+
+/* Width (in years) of each bucket of the age histogram, and the number of buckets (the last bucket holds every age above the others) */
+#define AGE_HISTOGRAM_WIDTH   10
+#define AGE_HISTOGRAM_BUCKETS 11
+
+/* Figures about the whole database, which are kept up to date as employees are added and deleted so that they can be printed without looking at every employee */
+int employee_count = 0;                            /* total number of employees */
+int male_count = 0, female_count = 0;              /* number of employees of each sex */
+int age_histogram[AGE_HISTOGRAM_BUCKETS];          /* number of employees with ages in each bucket */
+job_group *job_group_view[JOB_GROUP_BUCKETS];      /* job groups for every employee in the database, as used by the job report */
+int job_group_view_count = 0;                      /* number of groups in job_group_view */
+int job_group_view_stale = 0;                      /* whether any group in job_group_view has ages_stale set */
+
+/* Codes for the operations that runtime metrics are kept for */
+#define METRIC_LOAD       0    /* read_employee_databases() */
+#define METRIC_GET_INPUT  1    /* get_input() */
+#define METRIC_PLACE      2    /* place_employee(), and each employee merge_employee_batch() and read_employee_databases() add */
+#define METRIC_SEARCH     3    /* search_for_employee() */
+#define METRIC_DELETE     4    /* delete_employee_from_list() and delete_employees_where() */
+#define METRIC_PRINT      5    /* menu_print_database() */
+#define METRIC_UPDATE     6    /* update_employee() */
+#define METRIC_OPERATIONS 7
+
+/* Array to store the names of the operations that runtime metrics are kept for.
+	 metric_name[METRIC_PLACE] evaluates to a pointer to the string "place" etc. */
+const char metric_name[METRIC_OPERATIONS][10] = {"load","get_input","place","search","delete","print","update"};
+
+/* Layout of each metrics histogram. Values below 2 * METRIC_SUB_BUCKETS have a bucket each. Above that, each range from a power of two
+	 up to the next is split into METRIC_SUB_BUCKETS buckets of equal width, so every value is counted to within 1 / METRIC_SUB_BUCKETS
+	 of itself (12.5%), however big. Bucket b >= 2 * METRIC_SUB_BUCKETS counts values whose top METRIC_SUB_BUCKET_BITS + 1 bits are
+	 b % METRIC_SUB_BUCKETS + METRIC_SUB_BUCKETS, with b / METRIC_SUB_BUCKETS - 1 bits below them */
+#define METRIC_SUB_BUCKET_BITS 3
+#define METRIC_SUB_BUCKETS     (1 << METRIC_SUB_BUCKET_BITS)
+#define METRIC_BUCKETS         (METRIC_SUB_BUCKETS * (64 - METRIC_SUB_BUCKET_BITS + 1))
+
+/* Runtime metrics structure, kept for each operation */
+struct operation_metrics_struct
+{
+	unsigned long count;                         /* number of calls */
+	unsigned long long total_time;               /* total time taken by the calls (in nanoseconds) */
+	unsigned long long max_time;                 /* time taken by the slowest call (in nanoseconds) */
+	unsigned long time_histogram[METRIC_BUCKETS];     /* number of calls taking each range of times (in nanoseconds) */
+	unsigned long long total_walk;               /* total number of employees visited by the calls */
+	unsigned long max_walk;                      /* most employees visited by a single call */
+	unsigned long walk_histogram[METRIC_BUCKETS];     /* number of calls visiting each range of numbers of employees */
+};
+
+/* Typedef structure as 'operation_metrics' to make it easier to use */
+typedef struct operation_metrics_struct operation_metrics;
+
+/* Runtime metrics for each operation */
+operation_metrics metrics[METRIC_OPERATIONS];
+
+/* Number of employees visited while walking the linked list, the skip list or the name index.
+	 This is only ever increased, and the number visited by an operation is the difference between its values before and after. */
+unsigned long employees_visited = 0;
+
+/* Structure for timing an operation, filled in by metrics_start() */
+struct metrics_timer_struct
+{
+	unsigned long long start_time;               /* the time the operation started (in nanoseconds) */
+	unsigned long start_visited;                 /* employees_visited when the operation started */
+};
+
+/* Typedef structure as 'metrics_timer' to make it easier to use */
+typedef struct metrics_timer_struct metrics_timer;
+
+/* Codes for the types of trace event, one for each tracepoint */
+#define TRACE_READ_LINE         0    /* read_line() read a line, value is its length (or -1 at the end of the file) */
+#define TRACE_PREFIX_MISMATCH   1    /* read_string() read a character that doesn't match the prefix, value is the character */
+#define TRACE_PLACE_EMPLOYEE    2    /* place_employee() found where employee belongs, between before and after */
+#define TRACE_SEARCH_VISIT      3    /* search_for_employee() looked at employee in the name index bucket */
+#define TRACE_SEARCH_RESULT     4    /* search_for_employee() found employee (0 if it wasn't found) */
+#define TRACE_DELETE_EMPLOYEE   5    /* delete_employee_from_list() or delete_employees_where() is deleting employee, which is between before and after */
+#define TRACE_END_OF_FILE_TEST  6    /* more_records_test() read a character, value is the character (or -1 for EOF) */
+#define TRACE_EVENT_TYPES       7
+
+/* Array to store the names of the types of trace event, as printed by TYLERJ-decode-trace.c */
+const char trace_event_name[TRACE_EVENT_TYPES][16] = {"read_line","prefix_mismatch","place_employee","search_visit",
+																											 "search_result","delete_employee","end_of_file_test"};
+
+/* Trace event structure. Every event is the same size, so recording one is just filling in the next slot of the ring buffer */
+struct trace_event_struct
+{
+	unsigned long long time;        /* when the event happened (in nanoseconds since tracing was first turned on) */
+	unsigned long long employee;    /* address of the employee the event is about (0 if none) */
+	unsigned long long before;      /* address of the employee before it in the linked list (0 if none) */
+	unsigned long long after;       /* address of the employee after it in the linked list (0 if none) */
+	int type;                       /* the type of event (uses the constants for types of trace event) */
+	int value;                      /* a number whose meaning depends on the type of event */
+};
+
+/* Typedef structure as 'trace_event' to make it easier to use */
+typedef struct trace_event_struct trace_event;
+
+/* Trace file header structure, written at the start of a trace file before the events (oldest first) */
+struct trace_file_header_struct
+{
+	char magic[8];                  /* TRACE_FILE_MAGIC, to recognise a trace file */
+	unsigned long long event_size;  /* sizeof(trace_event), to check the trace is read by a program built the same way */
+	unsigned long long recorded;    /* number of events recorded, which is more than the number in the file if the ring buffer filled up */
+	unsigned long long saved;       /* number of events in the file */
+};
+
+/* Typedef structure as 'trace_file_header' to make it easier to use */
+typedef struct trace_file_header_struct trace_file_header;
+
+#define TRACE_FILE_MAGIC "EMPTRACE"
+
+/* Number of events kept in each ring buffer. When it is full, each new event replaces the oldest one */
+#define TRACE_RING_SIZE 65536
+
+/* Trace buffer structure, holding the ring buffer of events recorded by one thread */
+struct trace_buffer_struct
+{
+	trace_event *events;                  /* the ring buffer, holding the last TRACE_RING_SIZE events */
+	unsigned long long recorded;          /* number of events recorded, the next goes in events[recorded % TRACE_RING_SIZE] */
+	int in_use;                           /* 1 while a thread is recording into it, 0 once that thread has finished */
+	struct trace_buffer_struct *next;     /* next buffer on the trace_buffers list */
+};
+
+/* Typedef structure as 'trace_buffer' to make it easier to use */
+typedef struct trace_buffer_struct trace_buffer;
+
+/* Name of the trace file when the EMPLOYEE_TRACE environment variable isn't set */
+#define DEFAULT_TRACE_FILE "employee3.trace"
+
+/* Tracing state. Each thread that reaches a tracepoint records into a ring buffer of its own (trace_ring), so the threads started by
+	 run_parallel_scan() and read_employee_batch() never share one. A buffer is handed back when its thread finishes, to be reused by the next
+	 thread that needs one, and every buffer is kept on the trace_buffers list so that they can be merged when the trace file is written */
+int tracing = 0;                                          /* whether the tracepoints record events */
+__thread trace_buffer *trace_ring = NULL;                 /* this thread's ring buffer, taken when it records its first event */
+trace_buffer *trace_buffers = NULL;                       /* every ring buffer allocated so far */
+int trace_buffer_count = 0;                               /* the number of buffers on trace_buffers */
+pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;   /* lock protecting trace_buffers, trace_buffer_count and the in_use flags */
+pthread_key_t trace_thread_key;                           /* key whose destructor hands a thread's buffer back when it finishes */
+unsigned long long trace_start_time;                      /* when tracing was first turned on (in nanoseconds) */
+const char *trace_file_name = DEFAULT_TRACE_FILE;         /* the file the trace is written to */
+
+/* Default and smallest memory budgets (in MiB) for sorting a database file without loading it (see sort_database_file()) */
+#define DEFAULT_SORT_BUDGET 64
+#define MIN_SORT_BUDGET     1
+
+/* Sort record structure, holding an employee read while sorting a database file.
+	 The strings are kept in a single buffer rather than in fixed size arrays, so that as many employees as possible fit in the memory budget. */
+struct sort_record_struct
+{
+	const char *name;             /* name string */
+	const char *job;              /* job string */
+	int  age;                     /* age */
+	char sex;                     /* sex identifier, either 'M' or 'F' */
+	long position;                /* position of the employee in the file, so that employees with the same name stay in the same order */
+};
+
+/* Typedef structure as 'sort_record' to make it easier to use */
+typedef struct sort_record_struct sort_record;
+
+/* Sorted run structure, used when merging the sorted runs of a database file */
+struct sorted_run_struct
+{
+	FILE *file_pointer;           /* temporary file holding the run, in the database file format */
+	employee *current;            /* the next employee from the run (NULL once the run is finished) */
+	int number;                   /* the order the run was made in (or the file was given in), so that employees with the same name stay in the same order */
+};
+
+/* Typedef structure as 'sorted_run' to make it easier to use */
+typedef struct sorted_run_struct sorted_run;
+
+/* The employees read for an import are handed a chunk of IMPORT_CHUNK_SIZE at a time to a thread that sorts each chunk while the rest are being read,
+	 and the sorted chunks are merged once the whole file has been read (see read_employee_batch()) */
+#define IMPORT_CHUNK_SIZE 65536
+
+/* Import sorter structure, shared by the thread reading an import and the thread sorting its chunks */
+struct import_sorter_struct
+{
+	ranked_employee **chunks;                     /* the chunks handed over so far, each IMPORT_CHUNK_SIZE employees apart from the last */
+	int chunk_count, chunk_space;                 /* the number of chunks handed over, and the number there is room for in chunks */
+	int sorted_count;                             /* the number of chunks sorted so far */
+	int last_chunk_length;                        /* the number of employees in the last chunk (once finished is set) */
+	int finished;                                 /* 1 once every chunk has been handed over */
+	pthread_mutex_t lock;                         /* lock protecting all of the above */
+	pthread_cond_t changed;                       /* signalled when a chunk is handed over, or finished is set */
+};
+
+/* Typedef structure as 'import_sorter' to make it easier to use */
+typedef struct import_sorter_struct import_sorter;
+
+/* Estimated bookkeeping that malloc() adds to each allocation, and the size that allocations are rounded up to (these are the figures for glibc on
+	 64 bit systems, and are only used for estimating memory use in the memory report) */
+#define MALLOC_OVERHEAD  8
+#define MALLOC_ALIGNMENT 16
+#define MALLOC_MINIMUM   32
+
+/* A tracepoint, which records an event if tracing is on (and costs a single test if it isn't) */
+#define TRACE(type, employee_ptr, before, after, value) \
+	do{ if(tracing) trace_event_add(type, employee_ptr, before, after, value); } while(0)
+
 /* Function prototypes, function descriptions can be found with the function definitions */
 static int read_line(FILE *fp, char *line, int max_length);
 static int read_string(FILE *fp, const char *prefix, char *string, int max_length);
 static void print_error(const char* string, int exit_status);
+static employee *allocate_employee(void);
+static void free_employee(employee *employee_to_free);
+static void set_employee_strings(employee *employee_to_set, const char *name, const char *job);
+static unsigned long hash_name(const char *name);
+static void name_index_add(employee *employee_to_add);
+static void name_index_remove(employee *employee_to_remove);
+static void bloom_filter_counters(unsigned long hash, unsigned char *counters[]);
+static void bloom_filter_add(unsigned long hash);
+static void bloom_filter_remove(unsigned long hash);
+static int bloom_filter_test(unsigned long hash);
+static employee *skip_list_next(const employee *current, int level);
+static void skip_list_set_next(employee *current, int level, employee *next);
+static employee *skip_list_find(const char *name, employee *update[]);
+static void skip_list_choose_levels(employee *employee_to_add);
+static void skip_list_add(employee *employee_to_add, employee *update[]);
+static void skip_list_remove(employee *employee_to_remove);
 static void get_input_validity_check(int loop_count, int from_file, int field_identifier);
 static employee *get_input(FILE *fp, int from_file);
 static void print_single_employee(FILE *fp, const employee *employee_to_print);
 static void place_employee(employee *employee_to_place);
-static employee *search_for_employee(const char *name_to_delete);
+static void link_employee(employee *employee_to_link, employee *update[]);
+static employee *search_for_employee(const char *name_to_find);
 static void delete_employee_from_list(employee *record_to_delete);
 static int end_of_file_test(FILE *file_pointer);
+static employee *read_employee_record(FILE *fp, int *invalid_field);
+static int more_records_test(FILE *file_pointer);
 static void menu_add_employee(void);
 static void menu_print_database(void);
 static void menu_delete_employee(void);
-static void read_employee_database (const char *file_name);
+static void read_employee_databases(const char *file_names[], int file_count);
+static int save_employee_database(const char *file_name);
+static void menu_save_database(void);
+static int sync_parent_directory(const char *file_name);
+static int match_word(const char **text, const char *word);
+static int compile_query(const char *text, query *compiled_query);
+static int condition_is_true(const condition *condition_to_test, const employee *employee_to_test);
+static employee *query_match_from(const query *compiled_query, employee *current_record);
+static employee *query_first(const query *compiled_query);
+static employee *query_next(const query *compiled_query, const employee *current_record);
+static void menu_search_database(void);
+static int compare_conditions(const condition *first, const condition *second);
+static int conditions_are_true(const condition conditions[], int condition_count, const employee *employee_to_test);
+static query_cache_entry *find_cached_query(const query *compiled_query);
+static void cache_query_results(const query *compiled_query, employee *results[], int result_count);
+static void add_query_result(employee ***results, int *space, int count, employee *result);
+static void invalidate_query_cache(const employee *changed_employee);
+static job_group *find_job_group(job_group *table[], int *group_count, const char *job, char sex);
+static void add_to_job_group(job_group *group, int age);
+static int compare_job_groups(const void *first, const void *second);
+static void print_job_report(job_group *table[], int group_count);
+static void menu_print_job_report(void);
+static void free_job_groups(job_group *table[]);
+static void remove_from_job_group(job_group *table[], int *group_count, job_group *group, int age);
+static void add_to_views(const employee *employee_to_add);
+static void remove_from_views(const employee *employee_to_remove);
+static void refresh_job_group_view(void);
+static void menu_print_summary(void);
+static int ranks_before(const ranked_employee *first, const ranked_employee *second, int oldest_first);
+static void sift_down(ranked_employee heap[], int heap_size, int i, int oldest_first);
+static int top_employees_by_age(const query *compiled_query, ranked_employee heap[], int count, int oldest_first);
+static void sort_by_age(employee *records[], int count, int oldest_first);
+static void menu_print_by_age(void);
+static employee *cursor_first(const cursor *position);
+static int print_page(cursor *position, int page_size);
+static void menu_print_pages(void);
+static int can_scan_in_parallel(const query *compiled_query);
+static int make_scan_partitions(scan_partition **partitions, int wanted);
+static void scan_one_partition(const parallel_scan *scan, scan_partition *partition);
+static void *scan_worker(void *scan);
+static void run_parallel_scan(parallel_scan *scan, const query *compiled_query, int scan_type);
+static void free_parallel_scan(parallel_scan *scan);
+static void merge_job_group(job_group *table[], int *group_count, const job_group *group_to_merge);
+static int compare_batch_employees(const void *first, const void *second);
+static ranked_employee *read_employee_batch(FILE *file_pointer, int *count);
+static void merge_employee_batch(ranked_employee batch[], int count);
+static void menu_import_employees(void);
+static int delete_employees_where(int (*should_delete)(const employee *employee_to_test, void *context), void *context);
+static int compare_names(const void *first, const void *second);
+static int name_is_in_list(const employee *employee_to_test, void *context);
+static int employee_matches_query(const employee *employee_to_test, void *context);
+static void menu_delete_listed_employees(void);
+static void menu_delete_matching_employees(void);
+static void update_employee(employee *employee_to_update, const employee *new_details);
+static int read_new_value(const char *field_name, const char *current_value, char *string, int max_length);
+static void menu_update_employee(void);
+static unsigned long long metrics_clock(void);
+static int metrics_bucket(unsigned long long value);
+static unsigned long long metrics_bucket_limit(int bucket);
+static void metrics_start(metrics_timer *timer);
+static void metrics_stop(int operation, const metrics_timer *timer);
+static unsigned long long metrics_percentile(const unsigned long histogram[], unsigned long count, unsigned long long largest, int percent);
+static void menu_print_metrics(void);
+static void dump_metrics(FILE *fp);
+static void trace_event_add(int type, const employee *employee_ptr, const employee *before, const employee *after, int value);
+static trace_buffer *acquire_trace_buffer(void);
+static void release_trace_buffer(void *buffer);
+static void start_tracing(void);
+static long write_trace_file(const char *file_name);
+static void menu_switch_tracing(void);
+static unsigned long malloc_footprint(unsigned long size);
+static long resident_set_size(void);
+static void print_memory_line(const char *label, double bytes, long employees);
+static void menu_print_memory_report(void);
+static int compare_sort_records(const void *first, const void *second);
+static FILE *write_sorted_run(sort_record records[], long count);
+static void write_sort_records(FILE *file_pointer, sort_record records[], long count);
+static void close_sorted_runs(FILE *runs[], int run_count);
+static int run_belongs_before(const sorted_run *first, const sorted_run *second);
+static void sift_down_runs(sorted_run *heap[], int heap_size, int i);
+static int merge_sorted_runs(FILE *runs[], int run_count, FILE *output);
+static int sort_database_file(const char *input_file_name, const char *output_file_name, unsigned long budget);
+static void hand_over_import_chunk(import_sorter *sorter, ranked_employee *chunk, int length, int finished);
+static void *import_sort_worker(void *sorter);
+static int import_chunk_length(const import_sorter *sorter, int chunk);
+static void sift_down_chunks(const import_sorter *sorter, const int positions[], int heap[], int heap_size, int i);
+static ranked_employee *merge_import_chunks(import_sorter *sorter, int count);
+static void free_import_chunks(import_sorter *sorter);
 
 /* codes for menu */
 #define ADD_CODE    0
 #define DELETE_CODE 1
 #define PRINT_CODE  2
 #define EXIT_CODE   3
+#define SAVE_CODE   4
+#define SEARCH_CODE 5
+#define REPORT_CODE 6
+#define SUMMARY_CODE 7
+#define AGE_ORDER_CODE 8
+#define PAGES_CODE 9
+#define IMPORT_CODE 10
+#define DELETE_LISTED_CODE 11
+#define DELETE_MATCHING_CODE 12
+#define UPDATE_CODE 13
+#define METRICS_CODE 14
+#define TRACE_CODE 15
+#define MEMORY_CODE 16
 
 /*
 	Function: main()
 	Purpose: A database program that allows the user to add employees, delete employees and print the database to the screen.
 					 An existing database saved into a formatted file can also be loaded into the program.
-	Arguments: The name of the database file to load (argv[1]).
+					 Alternatively, a database file can be sorted into another file without loading it (see sort_database_file()).
+	Arguments: The names of the database files to load (argv[1] onwards), whose employees are merged into one database.
+						 Or, to sort a database file, "-s" (argv[1]), the names of the file to sort and the sorted file to write (argv[2] and argv[3]),
+							and optionally the memory budget in MiB (argv[4]).
 	Return value: EXIT_SUCCESS (0) or EXIT_FAILURE (1)
 	Inputs from user: Prompts to chose an option from the menu, and promts when inputting a new employee.
 	Outputs to user: Prompts (printed to stderr)
 									 All the employees indatabase (if the user selects that option from the menu), printed to stdout.
 									 Relevant error messages (printed to stderr)
 									 The program may exit without user promption, due to either a problem with the specified database file or a memory allocation error.
-									 Debugging messages may be printed to stderr, if any of the #define lines are uncommented at the top of the source code.
+									 A trace file is written on exit, if tracing was turned on.
  */
 int main ( int argc, char *argv[] )
 {
+   /* sort a database file into another without loading it, if asked to */
+   if ( ( argc == 4 || argc == 5 ) && strcmp ( argv[1], "-s" ) == 0 )
+   {
+      if ( argc == 5 && atol ( argv[4] ) < MIN_SORT_BUDGET )
+      {
+	 fprintf ( stderr, "The memory budget must be at least %d MiB.\n", MIN_SORT_BUDGET );
+	 exit(-1);
+      }
+      return sort_database_file ( argv[2], argv[3], ( argc == 5 ? atol ( argv[4] ) : DEFAULT_SORT_BUDGET ) * 1024UL * 1024UL ) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+   }
+
    /* check arguments */
-   if ( argc != 1 && argc != 2 )
+   if ( argc > 1 && argv[1][0] == '-' )
    {
-      fprintf ( stderr, "Usage: %s [<database-file>]\n", argv[0] );
+      fprintf ( stderr, "Usage: %s [<database-file> ...]\n", argv[0] );
+      fprintf ( stderr, "       %s -s <database-file> <sorted-file> [<memory-budget-MiB>]\n", argv[0] );
       exit(-1);
    }
 
-   /* read database file if provided, or start with empty database */
-   if ( argc == 2 )
-      read_employee_database ( argv[1] );
+   /* trace from the start if asked to by the environment */
+   if ( getenv ( "EMPLOYEE_TRACE" ) != NULL )
+   {
+      trace_file_name = getenv ( "EMPLOYEE_TRACE" );
+      start_tracing();
+   }
+
+   /* stdout is only used for printing employees, so it is fully buffered (and flushed after each menu option) rather than
+      line buffered when it is a terminal, which would mean a separate write for every line of the database */
+   setvbuf ( stdout, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE );
+
+   /* read database files if provided, or start with empty database
+      (the database is saved to the file by default when there is only one, but saving a merged database needs a file name, so that none
+      of the files it was merged from is overwritten by mistake) */
+   if ( argc >= 2 )
+   {
+      read_employee_databases ( (const char **) ( argv + 1 ), argc - 1 );
+      if ( argc == 2 )
+         database_file_name = argv[1];
+   }
 
    for(;;)
    {
@@ -135,9 +713,28 @@ int main ( int argc, char *argv[] )
       fprintf ( stderr, "%d: Delete employee from database\n", DELETE_CODE );
       fprintf ( stderr, "%d: Print database to screen\n", PRINT_CODE );
       fprintf ( stderr, "%d: Exit database program\n", EXIT_CODE );
+      fprintf ( stderr, "%d: Save database to file\n", SAVE_CODE );
+      fprintf ( stderr, "%d: Search database\n", SEARCH_CODE );
+      fprintf ( stderr, "%d: Print job report\n", REPORT_CODE );
+      fprintf ( stderr, "%d: Print database summary\n", SUMMARY_CODE );
+      fprintf ( stderr, "%d: Print employees in order of age\n", AGE_ORDER_CODE );
+      fprintf ( stderr, "%d: Print database a page at a time\n", PAGES_CODE );
+      fprintf ( stderr, "%d: Import employees from file\n", IMPORT_CODE );
+      fprintf ( stderr, "%d: Delete employees listed in file\n", DELETE_LISTED_CODE );
+      fprintf ( stderr, "%d: Delete employees matching query\n", DELETE_MATCHING_CODE );
+      fprintf ( stderr, "%d: Update an employee\n", UPDATE_CODE );
+      fprintf ( stderr, "%d: Print runtime statistics\n", METRICS_CODE );
+      fprintf ( stderr, "%d: Turn tracing %s\n", TRACE_CODE, tracing ? "off" : "on" );
+      fprintf ( stderr, "%d: Print memory report\n", MEMORY_CODE );
       fprintf ( stderr, "\nEnter option: " );
 
-      if ( read_line ( stdin, line, 300 ) != 0 ) continue;
+      /* stop at the end of the input (e.g. when the menu choices are piped in from another program), as if exit was chosen */
+      if ( read_line ( stdin, line, 300 ) != 0 )
+      {
+	 if ( feof ( stdin ) )
+	    break;
+	 continue;
+      }
 
       result = sscanf ( line, "%d", &choice );
       if ( result != 1 )
@@ -165,16 +762,85 @@ int main ( int argc, char *argv[] )
          case EXIT_CODE:
 	 break;
 
+         case SAVE_CODE: /* save database contents to a file */
+	 menu_save_database();
+	 break;
+
+         case SEARCH_CODE: /* print employees matching a query to screen
+			      (standard output) */
+	 menu_search_database();
+	 break;
+
+         case REPORT_CODE: /* print head count and ages by job to screen
+			      (standard output) */
+	 menu_print_job_report();
+	 break;
+
+         case SUMMARY_CODE: /* print head count, sex split and age histogram to screen
+			       (standard output) */
+	 menu_print_summary();
+	 break;
+
+         case AGE_ORDER_CODE: /* print employees in order of age to screen
+				 (standard output) */
+	 menu_print_by_age();
+	 break;
+
+         case PAGES_CODE: /* print database contents to screen a page at a time
+			     (standard output) */
+	 menu_print_pages();
+	 break;
+
+         case IMPORT_CODE: /* add all the employees in a file to database */
+	 menu_import_employees();
+	 break;
+
+         case DELETE_LISTED_CODE: /* delete employees named in a file from database */
+	 menu_delete_listed_employees();
+	 break;
+
+         case DELETE_MATCHING_CODE: /* delete employees matching a query from database */
+	 menu_delete_matching_employees();
+	 break;
+
+         case UPDATE_CODE: /* change the details of an employee in database */
+	 menu_update_employee();
+	 break;
+
+         case METRICS_CODE: /* print runtime statistics to screen */
+	 menu_print_metrics();
+	 break;
+
+         case TRACE_CODE: /* turn tracing on or off */
+	 menu_switch_tracing();
+	 break;
+
+         case MEMORY_CODE: /* print memory report to screen */
+	 menu_print_memory_report();
+	 break;
+
          default:
 	 fprintf ( stderr, "illegal choice %d\n", choice );
 	 break;
       }
 
+      /* make sure anything printed by the menu option is shown */
+      fflush ( stdout );
+
       /* check for exit menu choice */
       if ( choice == EXIT_CODE )
 	 break;
    }
 
+   /* leave the runtime metrics where a script running the program can collect them,
+      starting on a new line as the last menu prompt doesn't end with one */
+   fputc ( '\n', stderr );
+   dump_metrics ( stderr );
+
+   /* save the trace, if there is one */
+   if ( trace_ring != NULL && write_trace_file ( trace_file_name ) < 0 )
+      fprintf ( stderr, "Error writing trace file %s.\n", trace_file_name );
+
    return 0;   
 }
 
@@ -189,46 +855,55 @@ int main ( int argc, char *argv[] )
 						 The string to store the output in (line)
 						 The maximumum number of characters to read (max_length)
 	Return value: 0 is returned upon successfully reading a line.
-								-1 is returned if the end of file character EOF is reached before the end of the line.
+								-1 is returned if the end of file character EOF is reached before the end of the line
+								(the string then holds whatever was read of the line, which is empty if nothing was).
 	Inputs from user: None, unless the file pointer is stdin.
-	Outputs to user: None, unless the "#define DEBUG_READ_LINE" line is uncommented at the top of the source code.
-									 If it is the function will output each character it reads (and the corresponding ASCII code) to stderr.
-									 (along with an explanatory message)
+	Outputs to user: None (a TRACE_READ_LINE event is recorded if tracing is on).
  */
 static int read_line ( FILE *fp, char *line, int max_length )
 {
-	int i;
-	char ch;
+	int i, length, newline;
+	
+	/* buffer that the line is read into, a chunk at a time */
+	char chunk[MAX_CHARS_TO_READ + 2];
 
 	/* initialize index to string character */
 	i = 0;
 
 	/* read to end of line, filling in characters in string up to its maximum length,
-		 and ignoring the rest, if any */
+		 and ignoring the rest, if any.
+		 The line is read with fgets() a chunk at a time, rather than a character at a time, as this is much quicker for large database files */
 	for(;;)
 	{
-		/* read next character */
-		ch = fgetc(fp);
+		/* read next chunk, and check for end of file error */
+		if ( fgets(chunk, sizeof(chunk), fp) == NULL )
+		{
+			/* terminate what was read of a last line with no end of line */
+			line[i] = '\0';
+			TRACE(TRACE_READ_LINE, NULL, NULL, NULL, -1);
+			return -1;
+		}
 
-		#ifdef DEBUG_READ_LINE
-		fprintf(stderr, "Read ascii %d which is a: %c ", ch, ch);
-		#endif
+		length = strlen(chunk);
 
-		/* check for end of file error */
-		if ( ch == EOF )
-			return -1;
+		/* check for end of line, which fgets() leaves at the end of the chunk */
+		newline = ( length > 0 && chunk[length - 1] == '\n' );
+		if ( newline )
+			length--;
+
+		/* fill characters in string if it is not already full*/
+		if ( length > max_length - i )
+			length = max_length - i;
+		memcpy(line + i, chunk, length);
+		i += length;
 
-		/* check for end of line */
-		if ( ch == '\n' )
+		if ( newline )
 		{
 			/* terminate string and return */
 			line[i] = '\0';
+			TRACE(TRACE_READ_LINE, NULL, NULL, NULL, i);
 			return 0;
 		}
-
-		/* fill character in string if it is not already full*/
-		if ( i < max_length )
-			line[i++] = ch;
 	}
 
 	/* the program should never reach here */
@@ -251,11 +926,8 @@ static int read_line ( FILE *fp, char *line, int max_length )
 								-1 is returned if the end of file character EOF is reached before the end of the line.
 								-1 is also returned if the prefix on the file pointer does not match the prefix specified.
 	Inputs from user: None, unless the file pointer is stdin.
-	Outputs to user: None, unless the "#define DEBUG_READ_STRING", or "#define DEBUG_READ_LINE" line is uncommented at the top of the source code.
-									 If "#define DEBUG_READ_STRING" is uncommented the function will output each prefix character it reads (and the corresponding ASCII code) to stderr.
-									 It will also have an explanatory message to say if each prefix character is "successful" (i.e the same as the specified prefix) or not.
-									 If "#define DEBUG_READ_LINE" is uncommented the function will output as described in the read_line() specification.
-									 This happens because read_string() calls read_line() to read the characters on the input buffer after the prefix.
+	Outputs to user: None (a TRACE_PREFIX_MISMATCH event is recorded if tracing is on and the prefix doesn't match,
+									 and read_line() records its own events).
  */
 
 static int read_string ( FILE *fp, const char *prefix, char *string, int max_length )
@@ -268,15 +940,9 @@ static int read_string ( FILE *fp, const char *prefix, char *string, int max_len
 		if ( (c = fgetc(fp)) != prefix[i] )
 		{
 			/* file input doesn't match prefix */
-			#ifdef DEBUG_READ_STRING
-			fprintf(stderr,"The failure character is: %c\nThis is an ascii code of: %d \n", c, c);#
-			#endif
+			TRACE(TRACE_PREFIX_MISMATCH, NULL, NULL, NULL, c);
 			return -1;
 		}
-		#ifdef DEBUG_READ_STRING
-		else
-			fprintf(stderr,"Success! the prefix character read was: %c\nThis is an ascii code of: %d \n", c, c);
-		#endif
    /* read remaining part of line of input into string */
    return ( read_line ( fp, string, max_length ) );
 }
@@ -303,89 +969,507 @@ static void print_error(const char* string, int exit_status)
 }
 
 /*
-	Function: get_input_validity_check()
-	Purpose: Used during database input to print error messages (to stderr) and prompts (to stdout) at appropriate times.
-					 The function will also exit if invalid input is found when reading from a file.
-	Arguments: An integer containing how many times the user has already been prompted to enter that field (loop_count).
-						 An integer deterimining whether the input is being taken from a file (from_file)
-							This uses the constants defined at the top of the source code (INPUT_FROM_USER and INPUT_FROM_FILE),
-							although will work by evaluating from_file as TRUE (for INPUT_FROM_FILE) or FALSE (for INPUT_FROM_USER) will work.
-						 A field identifier, for determining which member of the structure is being input
-							(uses the constants for structure members defined prevously)
-	Return value: None.
+	Function: allocate_employee()
+	Purpose: Allocate the memory for a single employee structure.
+					 The structure is taken from the free list if there is one on it, otherwise a new block of EMPLOYEES_PER_BLOCK structures is allocated
+					 and all but the first of them are put on the free list.
+	Arguments: None.
+	Return value: A pointer to the employee structure that was allocated.
 	Inputs from user: None.
-	Outputs to user: The error messages that are printed to stderr.
-									 The prompts that are printed to stdout.
-									 The fact that the program may terminate.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
  */
-static void get_input_validity_check(int loop_count, int from_file, int field_identifier)
+static employee *allocate_employee(void)
 {
-	if( loop_count>0 && !(from_file) ){
-		print_error("Invalid ", DO_NOT_EXIT);
-		print_error(structure_member_name[field_identifier], DO_NOT_EXIT);
-		print_error(", please enter again.\n", DO_NOT_EXIT);
-	}else if( loop_count>0 && from_file ){
-		print_error("Invalid ", DO_NOT_EXIT);
-		print_error(structure_member_name[field_identifier], DO_NOT_EXIT);
-		print_error(" found in database file, program will now exit.\n", DO_EXIT);
+	employee *new_employee;
+	int i;
+
+	/* If the free list is empty, allocate a new block and put every structure in it on the free list */
+	if(free_employees == NULL)
+	{
+		new_employee = (employee *)malloc(EMPLOYEES_PER_BLOCK * sizeof(employee));
+
+		/* If new_employee is NULL, the memory allocation failed. */
+		if(new_employee == NULL)
+			print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
+		employee_blocks++;
+
+		for(i = 0; i < EMPLOYEES_PER_BLOCK; i++)
+		{
+			new_employee[i].next = free_employees;
+			free_employees = &new_employee[i];
+		}
 	}
-	
-	if(!from_file)
-		fprintf(stderr, "%s", structure_member_prefix[PREFIX_ON][field_identifier]);
-		
+
+	/* Take the first structure off the free list */
+	new_employee = free_employees;
+	free_employees = new_employee->next;
+	new_employee->skip_next = NULL;
+	new_employee->name = new_employee->job = NULL;
+
+	return new_employee;
+}
+
+/*
+	Function: free_employee()
+	Purpose: Return an employee structure that is no longer needed to the free list, so that it can be reused by allocate_employee().
+					 The employee's skip list pointers (if it has any) and its name and job strings are freed.
+	Arguments: A pointer to the employee structure to free (employee_to_free).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void free_employee(employee *employee_to_free)
+{
+	free(employee_to_free->skip_next);
+	free(employee_to_free->name);
+	employee_to_free->next = free_employees;
+	free_employees = employee_to_free;
 	return;
 }
 
 /*
-	Function: get_input()
-	Purpose: Used during database input to read the input from a file pointer, allocate memory for an employee structure and save the input to that structure.
-					 If input is being read from the user, the program will loop until the user gives valid input.
-					 If input if being read from a file, the program will exit if invalid input is given.
-						An error message will be printed to stderr for both of the above cases.
-					 If input is being read from the user, get_input will prompt the user for each structure member.
-					 If input is being read from a file, get_input() will read (and ignore) the prompts specified in structure_member_prefix[][][] from the file.
-	Arguments: A file pointer to read the input from (fp).
-						 An integer determining if the input is from a file or from the user (from_file).
-							This uses the constants INPUT_FROM_USER and INPUT_FROM_FILE, specified above.
-							However any integer that evaluates as FALSE (for INPUT_FROM_USER) or TRUE (for INPUT_FROM_FILE) will work.
-	Return value: A pointer to the employee structure that the input is saved in.
+	Function: set_employee_strings()
+	Purpose: Give an employee a new name and job, in a single allocation just big enough for both strings (the name, then the job).
+					 The new strings are copied before the old allocation is freed, so either may be the employee's own current name or job.
+	Arguments: The employee to set the strings of (employee_to_set).
+						 The new name and job (name and job).
+	Return value: None.
 	Inputs from user: None.
-	Outputs to user: The error messages that are printed to stderr.
-									 The prompts that are printed to stderr.
-									 The fact that the program may terminate if there is a problem allocating memory for the employee structure, or if there is invalid input.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
  */
-static employee *get_input(FILE *fp, int from_file)
+static void set_employee_strings(employee *employee_to_set, const char *name, const char *job)
 {
-	/* Allocate memory for an employee structure */
-	employee *employee_input;
-	employee_input = (employee *)malloc(sizeof(employee));
-	
-	/* If employee_input is NULL, the memory allocation failed. */
-	if(employee_input == NULL)
+	size_t name_size = strlen(name) + 1, job_size = strlen(job) + 1;
+	char *strings = (char *)malloc(name_size + job_size);
+
+	if(strings == NULL)
 		print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
 
-	/* Buffer to temporarily store input for structure members that are not stored as strings */
-	char buffer[MAX_CHARS_TO_READ + 1];
-	
-	/* A loop counter, for determining when to write the error messages */
-	int loop_count;
-	
-	/* This for loop initially sets the first character of employee_input->name to '\0', meaning the string is empty.
-		 It then loops until sscanf(employee_input->name,"%1[^\n]", buffer) returns 1, meaning that the user has entered something.
-		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
-		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
-		 An error message is given to the user each time invalid input is read. */
-	for(employee_input->name[0] = '\0', loop_count=0; sscanf(employee_input->name,"%1[^\n]", buffer) < 1; loop_count++)
+	memcpy(strings, name, name_size);
+	memcpy(strings + name_size, job, job_size);
+
+	free(employee_to_set->name);
+	employee_to_set->name = strings;
+	employee_to_set->job = strings + name_size;
+	return;
+}
+
+/*
+	Function: hash_name()
+	Purpose: Calculate a hash of a name string (using the FNV-1a algorithm), which is used to decide which bucket of the name index an employee belongs in.
+	Arguments: The name string to hash (name).
+	Return value: The hash of the name.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long hash_name(const char *name)
+{
+	unsigned long hash = 2166136261UL;
+
+	for(; *name != '\0'; name++)
 	{
-		get_input_validity_check(loop_count, from_file, NAME_IDENTIFIER);
-		if(read_string(fp, structure_member_prefix[from_file][NAME_IDENTIFIER], employee_input->name, MAX_NAME_LENGTH) == -1)
-			print_error(file_read_failure, DO_EXIT);
+		hash ^= (unsigned char)*name;
+		hash = (hash * 16777619UL) & 0xFFFFFFFFUL;
 	}
 
-	/* This for loop initially sets employee_input->sex to '\0', so that it is definitely neither 'M' or 'F'
-		 It then loops until only one character has been entered, and that character is either 'M' or 'F'
-		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
-		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
+	return hash;
+}
+
+/*
+	Function: name_index_add()
+	Purpose: Add an employee to the name index, by calculating the hash of its name and putting it at the start of the relevant bucket.
+					 The name is also added to the Bloom filter.
+	Arguments: A pointer to the employee to add to the index (employee_to_add).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void name_index_add(employee *employee_to_add)
+{
+	employee **bucket;
+
+	employee_to_add->name_hash = hash_name(employee_to_add->name);
+	bucket = &name_index[employee_to_add->name_hash % NAME_INDEX_BUCKETS];
+
+	employee_to_add->bucket_next = *bucket;
+	*bucket = employee_to_add;
+	bloom_filter_add(employee_to_add->name_hash);
+
+	return;
+}
+
+/*
+	Function: name_index_remove()
+	Purpose: Remove an employee from the name index (and its name from the Bloom filter).
+	Arguments: A pointer to the employee to remove from the index (employee_to_remove).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void name_index_remove(employee *employee_to_remove)
+{
+	employee **link;
+
+	/* Find the pointer that points to employee_to_remove, and make it point to the employee after it in the bucket instead */
+	for(link = &name_index[employee_to_remove->name_hash % NAME_INDEX_BUCKETS]; *link != NULL; link = &((*link)->bucket_next))
+		if(*link == employee_to_remove)
+		{
+			*link = employee_to_remove->bucket_next;
+			bloom_filter_remove(employee_to_remove->name_hash);
+			break;
+		}
+
+	return;
+}
+
+/*
+	Function: bloom_filter_counters()
+	Purpose: Find the Bloom filter counters that a name uses.
+					 The hash of the name is mixed (so that the counters don't depend on the same bits as the name index bucket),
+					 and the top bits pick the block, with the next bits picking each counter in the block.
+	Arguments: The hash of the name, from hash_name() (hash).
+						 The array to store pointers to the BLOOM_FILTER_HASHES counters in (counters).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void bloom_filter_counters(unsigned long hash, unsigned char *counters[])
+{
+	unsigned long long mixed = (hash + 1) * 0x9E3779B97F4A7C15ULL;
+	unsigned char *block = bloom_filter[(mixed >> 32) % BLOOM_FILTER_BLOCKS];
+	int i;
+
+	for(i = 0; i < BLOOM_FILTER_HASHES; i++)
+		counters[i] = &block[(mixed >> (6 * i)) % BLOOM_FILTER_BLOCK_SIZE];
+
+	return;
+}
+
+/*
+	Function: bloom_filter_add()
+	Purpose: Add a name to the Bloom filter, by adding one to each of its counters.
+	Arguments: The hash of the name, from hash_name() (hash).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void bloom_filter_add(unsigned long hash)
+{
+	unsigned char *counters[BLOOM_FILTER_HASHES];
+	int i;
+
+	bloom_filter_counters(hash, counters);
+	for(i = 0; i < BLOOM_FILTER_HASHES; i++)
+		if(*counters[i] < BLOOM_FILTER_MAX_COUNT)
+			(*counters[i])++;
+
+	return;
+}
+
+/*
+	Function: bloom_filter_remove()
+	Purpose: Remove a name that was added to the Bloom filter, by taking one from each of its counters (apart from any that have reached BLOOM_FILTER_MAX_COUNT).
+	Arguments: The hash of the name, from hash_name() (hash).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void bloom_filter_remove(unsigned long hash)
+{
+	unsigned char *counters[BLOOM_FILTER_HASHES];
+	int i;
+
+	bloom_filter_counters(hash, counters);
+	for(i = 0; i < BLOOM_FILTER_HASHES; i++)
+		if(*counters[i] < BLOOM_FILTER_MAX_COUNT)
+			(*counters[i])--;
+
+	return;
+}
+
+/*
+	Function: bloom_filter_test()
+	Purpose: Find whether a name might be in the database, according to the Bloom filter.
+	Arguments: The hash of the name, from hash_name() (hash).
+	Return value: 0 if the name is definitely not in the database.
+								1 if it might be (so the name index has to be searched to find out).
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int bloom_filter_test(unsigned long hash)
+{
+	unsigned char *counters[BLOOM_FILTER_HASHES];
+	int i;
+
+	bloom_filter_counters(hash, counters);
+	for(i = 0; i < BLOOM_FILTER_HASHES; i++)
+		if(*counters[i] == 0)
+			return 0;
+
+	return 1;
+}
+
+/*
+	Function: skip_list_next()
+	Purpose: Find the employee after a given employee on a given level of the skip list.
+	Arguments: A pointer to the current employee (current), or NULL to get the first employee on that level.
+						 The level of the skip list to use (level).
+	Return value: A pointer to the next employee on that level, or NULL if there isn't one.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *skip_list_next(const employee *current, int level)
+{
+	if(current == NULL)
+		return level == 0 ? head : skip_list_head[level];
+	return level == 0 ? current->next : current->skip_next[level - 1];
+}
+
+/*
+	Function: skip_list_set_next()
+	Purpose: Set the employee after a given employee on a given level of the skip list.
+	Arguments: A pointer to the current employee (current), or NULL to set the first employee on that level.
+						 The level of the skip list to use (level).
+						 A pointer to the employee that should come next (next).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void skip_list_set_next(employee *current, int level, employee *next)
+{
+	if(current == NULL)
+	{
+		if(level == 0)
+			head = next;
+		else
+			skip_list_head[level] = next;
+	}else if(level == 0)
+		current->next = next;
+	else
+		current->skip_next[level - 1] = next;
+	return;
+}
+
+/*
+	Function: skip_list_find()
+	Purpose: Find the last employee on each level of the skip list whose name belongs before a given name.
+					 Starting from the highest level, the function moves along each level until the next employee's name is not before the given name,
+					 and then drops down a level.
+	Arguments: The name to search for (name).
+						 An array of SKIP_LIST_MAX_LEVELS pointers to store the last employee found on each level in (update), or NULL if these aren't needed.
+	Return value: A pointer to the last employee in the linked list whose name belongs before the given name.
+								A pointer to NULL will be returned if the given name belongs at the start of the list.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *skip_list_find(const char *name, employee *update[])
+{
+	employee *current = NULL, *next;
+	int level;
+
+	for(level = skip_list_levels - 1; level >= 0; level--)
+	{
+		/* If the strcmp is < 0, the next employee's name belongs BEFORE the given name */
+		for(next = skip_list_next(current, level); next != NULL && strcmp(next->name, name) < 0; next = skip_list_next(current, level))
+		{
+			current = next;
+			employees_visited++;
+		}
+
+		if(update != NULL)
+			update[level] = current;
+	}
+
+	return current;
+}
+
+/*
+	Function: skip_list_choose_levels()
+	Purpose: Pick how many skip list levels a new employee should be on, and allocate its pointers for levels 1 and above.
+	Arguments: A pointer to the new employee (employee_to_add).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void skip_list_choose_levels(employee *employee_to_add)
+{
+	/* Each extra level has a 1 in SKIP_LIST_CHANCE chance of being used */
+	for(employee_to_add->skip_levels = 1; employee_to_add->skip_levels < SKIP_LIST_MAX_LEVELS && rand() % SKIP_LIST_CHANCE == 0; employee_to_add->skip_levels++)
+		;
+
+	employee_to_add->skip_next = NULL;
+	if(employee_to_add->skip_levels == 1)
+		return;
+
+	employee_to_add->skip_next = (employee **)malloc((employee_to_add->skip_levels - 1) * sizeof(employee *));
+	if(employee_to_add->skip_next == NULL)
+		print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
+
+	return;
+}
+
+/*
+	Function: skip_list_add()
+	Purpose: Pick how many skip list levels a new employee should be on, and link it into levels 1 and above of the skip list.
+					 (The caller links the employee into level 0, i.e the linked list, itself.)
+	Arguments: A pointer to the employee to add (employee_to_add).
+						 The array filled in by skip_list_find() for the employee's name (update).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void skip_list_add(employee *employee_to_add, employee *update[])
+{
+	int level;
+
+	skip_list_choose_levels(employee_to_add);
+
+	/* Levels that weren't in use before start empty, so the employee goes at the start of them */
+	for(; skip_list_levels < employee_to_add->skip_levels; skip_list_levels++)
+		update[skip_list_levels] = NULL;
+
+	for(level = 1; level < employee_to_add->skip_levels; level++)
+	{
+		skip_list_set_next(employee_to_add, level, skip_list_next(update[level], level));
+		skip_list_set_next(update[level], level, employee_to_add);
+	}
+
+	return;
+}
+
+/*
+	Function: skip_list_remove()
+	Purpose: Unlink an employee from levels 1 and above of the skip list.
+					 (The caller unlinks the employee from level 0, i.e the linked list, itself.)
+	Arguments: A pointer to the employee to remove (employee_to_remove).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void skip_list_remove(employee *employee_to_remove)
+{
+	employee *update[SKIP_LIST_MAX_LEVELS];
+	employee *current;
+	int level;
+
+	if(employee_to_remove->skip_levels == 1)
+		return;
+
+	skip_list_find(employee_to_remove->name, update);
+
+	/* update[] holds the employees before the first one with this name, so move past any others with the same name on each level */
+	for(level = 1; level < employee_to_remove->skip_levels; level++)
+	{
+		for(current = update[level]; skip_list_next(current, level) != employee_to_remove; current = skip_list_next(current, level))
+			employees_visited++;
+		skip_list_set_next(current, level, skip_list_next(employee_to_remove, level));
+	}
+
+	return;
+}
+
+/*
+	Function: get_input_validity_check()
+	Purpose: Used during database input to print error messages (to stderr) and prompts (to stdout) at appropriate times.
+					 The function will also exit if invalid input is found when reading from a file.
+	Arguments: An integer containing how many times the user has already been prompted to enter that field (loop_count).
+						 An integer deterimining whether the input is being taken from a file (from_file)
+							This uses the constants defined at the top of the source code (INPUT_FROM_USER and INPUT_FROM_FILE),
+							although will work by evaluating from_file as TRUE (for INPUT_FROM_FILE) or FALSE (for INPUT_FROM_USER) will work.
+						 A field identifier, for determining which member of the structure is being input
+							(uses the constants for structure members defined prevously)
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The error messages that are printed to stderr.
+									 The prompts that are printed to stdout.
+									 The fact that the program may terminate.
+ */
+static void get_input_validity_check(int loop_count, int from_file, int field_identifier)
+{
+	if( loop_count>0 && !(from_file) ){
+		print_error("Invalid ", DO_NOT_EXIT);
+		print_error(structure_member_name[field_identifier], DO_NOT_EXIT);
+		print_error(", please enter again.\n", DO_NOT_EXIT);
+	}else if( loop_count>0 && from_file ){
+		print_error("Invalid ", DO_NOT_EXIT);
+		print_error(structure_member_name[field_identifier], DO_NOT_EXIT);
+		print_error(" found in database file, program will now exit.\n", DO_EXIT);
+	}
+	
+	if(!from_file)
+		fprintf(stderr, "%s", structure_member_prefix[PREFIX_ON][field_identifier]);
+		
+	return;
+}
+
+/*
+	Function: get_input()
+	Purpose: Used during database input to read the input from a file pointer, allocate memory for an employee structure and save the input to that structure.
+					 If input is being read from the user, the program will loop until the user gives valid input.
+					 If input if being read from a file, the program will exit if invalid input is given.
+						An error message will be printed to stderr for both of the above cases.
+					 If input is being read from the user, get_input will prompt the user for each structure member.
+					 If input is being read from a file, get_input() will read (and ignore) the prompts specified in structure_member_prefix[][][] from the file.
+	Arguments: A file pointer to read the input from (fp).
+						 An integer determining if the input is from a file or from the user (from_file).
+							This uses the constants INPUT_FROM_USER and INPUT_FROM_FILE, specified above.
+							However any integer that evaluates as FALSE (for INPUT_FROM_USER) or TRUE (for INPUT_FROM_FILE) will work.
+	Return value: A pointer to the employee structure that the input is saved in.
+	Inputs from user: None.
+	Outputs to user: The error messages that are printed to stderr.
+									 The prompts that are printed to stderr.
+									 The fact that the program may terminate if there is a problem allocating memory for the employee structure, or if there is invalid input.
+ */
+static employee *get_input(FILE *fp, int from_file)
+{
+	/* Records in a file are read by read_employee_record(), and any problem with one is reported in the same way as invalid input from the user
+		 (but the program then exits) */
+	if(from_file)
+	{
+		int invalid_field;
+		employee *employee_read = read_employee_record(fp, &invalid_field);
+
+		if(employee_read == NULL)
+		{
+			if(invalid_field == -1)
+				print_error(file_read_failure, DO_EXIT);
+			get_input_validity_check(1, from_file, invalid_field);
+		}
+		return employee_read;
+	}
+
+	metrics_timer timer;
+	metrics_start(&timer);
+
+	/* Allocate memory for an employee structure */
+	employee *employee_input;
+	employee_input = allocate_employee();
+
+	/* Buffer to temporarily store input for structure members that are not stored as strings */
+	char buffer[MAX_CHARS_TO_READ + 1];
+
+	/* Buffers to read the name and job into, before they are copied into an allocation of the right size */
+	char name[MAX_NAME_LENGTH + 1], job[MAX_JOB_LENGTH + 1];
+	
+	/* A loop counter, for determining when to write the error messages */
+	int loop_count;
+	
+	/* This for loop initially sets the first character of name to '\0', meaning the string is empty.
+		 It then loops until sscanf(name,"%1[^\n]", buffer) returns 1, meaning that the user has entered something.
+		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
+		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
+		 An error message is given to the user each time invalid input is read. */
+	for(name[0] = '\0', loop_count=0; sscanf(name,"%1[^\n]", buffer) < 1; loop_count++)
+	{
+		get_input_validity_check(loop_count, from_file, NAME_IDENTIFIER);
+		if(read_string(fp, structure_member_prefix[from_file][NAME_IDENTIFIER], name, MAX_NAME_LENGTH) == -1)
+			print_error(file_read_failure, DO_EXIT);
+	}
+
+	/* This for loop initially sets employee_input->sex to '\0', so that it is definitely neither 'M' or 'F'
+		 It then loops until only one character has been entered, and that character is either 'M' or 'F'
+		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
+		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
 		 An error message is given to the user each time invalid input is read. */
 	for(employee_input->sex = '\0', buffer[1] = 'a', loop_count=0; (employee_input->sex != 'M') && (employee_input->sex != 'F'); loop_count++)
 	{
@@ -415,361 +1499,3835 @@ static employee *get_input(FILE *fp, int from_file)
 		if( sscanf(buffer,"%d%1[^\n]", &(employee_input->age), buffer) != 1 )
 			employee_input->age = -1;
 
-	}
+	}
+
+	/* This for loop initially sets the first character of job to '\0', meaning the string is empty.
+		 It then loops until sscanf(job,"%1[^\n]", buffer) returns 1, meaning that the user has entered something.
+		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
+		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
+		 An error message is given to the user each time invalid input is read. */
+	for(job[0] = '\0', loop_count=0; sscanf(job,"%1[^\n]", buffer) < 1; loop_count++)
+	{
+		get_input_validity_check(loop_count, from_file, JOB_IDENTIFIER);
+		if(read_string(fp, structure_member_prefix[from_file][JOB_IDENTIFIER], job, MAX_JOB_LENGTH) == -1)
+			print_error(file_read_failure, DO_EXIT);
+	}
+
+	set_employee_strings(employee_input, name, job);
+
+	metrics_stop(METRIC_GET_INPUT, &timer);
+
+	/* Return the address of the employee structure containing the input */
+	return employee_input;
+}
+
+/*
+	Function: print_single_employee()
+	Purpose: Output the details of a single employee record to a specified output stream
+	Arguments: The stream to print the details of the employee onto (fp)
+						 The address of the employee record to print (employee_to_print)
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The employee that is printed.
+ */
+static void print_single_employee(FILE *fp, const employee *employee_to_print)
+{
+	/* All four lines are written with a single call, as most of the time taken printing the database is spent in the stdio calls */
+	fprintf(fp, "%s%s\n%s%c\n%s%d\n%s%s\n",
+					structure_member_prefix[PREFIX_ON][NAME_IDENTIFIER], employee_to_print->name,
+					structure_member_prefix[PREFIX_ON][SEX_IDENTIFIER], employee_to_print->sex,
+					structure_member_prefix[PREFIX_ON][AGE_IDENTIFIER], employee_to_print->age,
+					structure_member_prefix[PREFIX_ON][JOB_IDENTIFIER], employee_to_print->job);
+	return;
+}
+
+/*
+	Function: place_employee()
+	Purpose: Place an employee record into the correct place (i.e alphabetical order by name) in the linked list.
+					 The skip list is used to find the correct place, and the record is added to the skip list and the name index.
+	Arguments: The address of the employee to add to the linked list.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None (a TRACE_PLACE_EMPLOYEE event is recorded if tracing is on).
+ */
+static void place_employee(employee *employee_to_place)
+{
+	/* The last employee found on each level of the skip list before employee_to_place belongs.
+		 update[0] will point to the record that belongs directly before employee_to_place */
+	employee *update[SKIP_LIST_MAX_LEVELS];
+	metrics_timer timer;
+	
+	metrics_start(&timer);
+
+	/* Find the last record whose name belongs before employee_to_place.
+		 This puts employee_to_place before (or is the same as) any records with the same name. */
+	skip_list_find(employee_to_place->name, update);
+	
+	/* update[0] is now directly before where employee_to_place belongs (NULL if it is the new head) */
+	TRACE(TRACE_PLACE_EMPLOYEE, employee_to_place, update[0], skip_list_next(update[0], 0), 0);
+	
+	link_employee(employee_to_place, update);
+	
+	metrics_stop(METRIC_PLACE, &timer);
+	return;
+}
+
+/*
+	Function: link_employee()
+	Purpose: Give an employee record a new id, and link it into the linked list directly after update[0] (or at the head if update[0] is NULL),
+					 and add it to the rest of the skip list, the name index and the figures kept about the database.
+					 Any remembered query results that the employee belongs in are thrown away.
+	Arguments: The address of the employee to link into the list (employee_to_link).
+						 The last employee on each level of the skip list before the employee belongs, as found by skip_list_find() (update).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void link_employee(employee *employee_to_link, employee *update[])
+{
+	/* The employee goes before any others with the same name, so needs a higher id than them */
+	employee_to_link->id = next_employee_id++;
+	
+	employee_to_link->prev = update[0];
+	employee_to_link->next = skip_list_next(update[0], 0);
+	
+	/* We need to see if there is another record after update[0], to avoid writing to NULL */
+	if(employee_to_link->next != NULL)
+		(employee_to_link->next)->prev = employee_to_link;
+	skip_list_set_next(update[0], 0, employee_to_link);
+	
+	skip_list_add(employee_to_link, update);
+	name_index_add(employee_to_link);
+	add_to_views(employee_to_link);
+	invalidate_query_cache(employee_to_link);
+	
+	return;
+}
+
+/*
+	Function: search_for_employee()
+	Purpose: Find the first employee in the linked list whose name matches a given string.
+					 Only the bucket of the name index that the name hashes to is searched, rather than the whole linked list.
+					 Most names that are not in the database are rejected by the Bloom filter, without looking at the bucket at all.
+	Arguments: A string containing the name of the employee to find (name_to_find).
+	Return value: A pointer to the employee structure whose name matches the given string.
+								A pointer to NULL will be returned if no employees match the given string.
+	Inputs from user: None.
+	Outputs to user: None (TRACE_SEARCH_VISIT and TRACE_SEARCH_RESULT events are recorded if tracing is on).
+ */
+static employee *search_for_employee(const char *name_to_find)
+{
+	/* Output structure */
+	employee *current_record;
+	
+	metrics_timer timer;
+	metrics_start(&timer);
+
+	/* Hash of the name to find, this decides which bucket to search */
+	unsigned long hash = hash_name(name_to_find);
+
+	/* If the Bloom filter says the name isn't in the database, there is no need to look at the bucket.
+		 Otherwise loop through the bucket, until an employee whose name matches name_to_find is found (or we reach the end of the bucket) */
+	current_record = bloom_filter_test(hash) ? name_index[hash % NAME_INDEX_BUCKETS] : NULL;
+	for(; current_record != NULL; current_record = current_record->bucket_next)
+	{
+		employees_visited++;
+		TRACE(TRACE_SEARCH_VISIT, current_record, NULL, NULL, 0);
+
+		/* If the name is found, break (the hashes are compared first, as this is quicker than comparing the strings) */
+		if(current_record->name_hash == hash && strcmp(name_to_find, current_record->name) == 0)
+				break;
+	}
+	
+	/* Employees with the same name are next to each other in the linked list, so step backwards to the first of them */
+	if(current_record != NULL)
+		while(current_record->prev != NULL && strcmp(name_to_find, (current_record->prev)->name) == 0)
+		{
+			current_record = current_record->prev;
+			employees_visited++;
+		}
+	
+	TRACE(TRACE_SEARCH_RESULT, current_record, NULL, NULL, 0);
+
+	metrics_stop(METRIC_SEARCH, &timer);
+
+	/* current_record will now either contain the address of the matching employee,
+			or NULL (since the bucket_next member of the last employee in the bucket is NULL) */
+	return current_record;
+}
+
+/*
+	Function: delete_employee_from_list()
+	Purpose: Remove an employee from the linked list, rearranging the pointers of the surrounding employees so that the list remains intact.
+	Arguments: A pointer to the employee record to remove.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None (a TRACE_DELETE_EMPLOYEE event is recorded if tracing is on).
+ */
+static void delete_employee_from_list(employee *record_to_delete)
+{
+	metrics_timer timer;
+	metrics_start(&timer);
+
+	TRACE(TRACE_DELETE_EMPLOYEE, record_to_delete, record_to_delete->prev, record_to_delete->next, 0);
+	
+	/* We have to check if the previous and next employees exist before we attempt to write to them */
+	if(record_to_delete->prev != NULL)
+		(record_to_delete->prev)->next = record_to_delete->next;
+	if(record_to_delete->next != NULL)
+		(record_to_delete->next)->prev = record_to_delete->prev;
+	
+	/* If we're removing the head, we need to make the head point to the next record in the list */
+	if(record_to_delete	== head)
+		head = record_to_delete->next;
+	
+	/* Remove the record from the skip list, the name index, the figures kept about the database and any remembered query results */
+	skip_list_remove(record_to_delete);
+	name_index_remove(record_to_delete);
+	remove_from_views(record_to_delete);
+	invalidate_query_cache(record_to_delete);
+		
+	/* Free the space used by the record that we're deleting */
+	free_employee(record_to_delete);
+	
+	metrics_stop(METRIC_DELETE, &timer);
+	return;
+}
+
+/*
+	Function: end_of_file_test()
+	Purpose: Get the input file into the correct position to read the next record, and check to see if the file contains any more records
+					 (see more_records_test()). The program exits if the file is incorrectly formatted.
+	Arguments: A file pointer to the stream to manipulate (file_pointer).
+	Return value: 0 if there are no more records on the file.
+								1 if there are more records on the file.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr), and the fact that the program will terminate, if the file is incorrectly formatted.
+ */
+static int end_of_file_test(FILE *file_pointer)
+{
+	int result = more_records_test(file_pointer);
+
+	if(result == -1)
+		print_error("Database file is incorrectly formatted, the program will now exit.\n", DO_EXIT);
+	return result;
+}
+
+/*
+	Function: more_records_test()
+	Purpose: Get the input file into the correct position to read the next record, and check to see if the file contains any more records.
+					 Each record must be followed by a blank line.
+	Arguments: A file pointer to the stream to manipulate (file_pointer).
+	Return value: 0 if there are no more records on the file.
+								1 if there are more records on the file.
+								-1 if the record just read isn't followed by a blank line, meaning the file is incorrectly formatted.
+	Inputs from user: None.
+	Outputs to user: None (a TRACE_END_OF_FILE_TEST event is recorded for each character tested if tracing is on).
+ */
+static int more_records_test(FILE *file_pointer)
+{
+	/* Integer to store the character that will be input */
+	int c;
+	/* Get the next character from the stream */
+	c = fgetc(file_pointer);
+	
+	TRACE(TRACE_END_OF_FILE_TEST, NULL, NULL, NULL, c);
+	
+	/* If the next character is NOT a \n, the database is incorrectly formatted */
+	if(c != '\n')
+		return -1;
+
+	/* If the character we got WAS a \n, try getting another to see if we're at the end of the file */
+	c = fgetc(file_pointer);
+	
+	TRACE(TRACE_END_OF_FILE_TEST, NULL, NULL, NULL, c);
+
+	/* If we did reach the end of the file when we got the second character, then return 0 */
+	if(feof(file_pointer))
+		return 0;
+	/* Otherwise, "unget" the character (i.e put it back on the stream) and return 1 */
+	ungetc(c, file_pointer);
+	return 1;
+}
+
+/*
+	Function: read_employee_record()
+	Purpose: Read a single employee record from a formatted database file (with the prefixes in structure_member_prefix[INPUT_FROM_FILE][]),
+					 and check it with the same rules that get_input() uses for input from the user.
+					 Nothing is printed, and the program doesn't exit, if the record is invalid.
+	Arguments: A file pointer to read the record from (fp).
+						 A pointer to where to store the field identifier of the invalid field, or -1 if a line couldn't be read (invalid_field),
+							if the record is invalid.
+	Return value: A pointer to the employee structure that the record is saved in.
+								NULL if the record is invalid (in which case nothing is left allocated).
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for the employee structure.
+ */
+static employee *read_employee_record(FILE *fp, int *invalid_field)
+{
+	char buffer[MAX_CHARS_TO_READ + 1];
+	char name[MAX_NAME_LENGTH + 1], sex[3], job[MAX_JOB_LENGTH + 1];
+	int age;
+	employee *employee_read;
+	metrics_timer timer;
+
+	metrics_start(&timer);
+	*invalid_field = -1;
+
+	/* Read each line, stopping at the first that is missing or invalid.
+		 The name and job mustn't be empty, the sex must be a single 'M' or 'F', and the age must be a whole number, at least zero, with nothing after it. */
+	if(read_string(fp, structure_member_prefix[INPUT_FROM_FILE][NAME_IDENTIFIER], name, MAX_NAME_LENGTH) == -1)
+		return NULL;
+	if(name[0] == '\0')
+	{
+		*invalid_field = NAME_IDENTIFIER;
+		return NULL;
+	}
+
+	if(read_string(fp, structure_member_prefix[INPUT_FROM_FILE][SEX_IDENTIFIER], sex, 2) == -1)
+		return NULL;
+	if((sex[0] != 'M' && sex[0] != 'F') || sex[1] != '\0')
+	{
+		*invalid_field = SEX_IDENTIFIER;
+		return NULL;
+	}
+
+	if(read_string(fp, structure_member_prefix[INPUT_FROM_FILE][AGE_IDENTIFIER], buffer, MAX_CHARS_TO_READ) == -1)
+		return NULL;
+	if(sscanf(buffer, "%d%1[^\n]", &age, buffer) != 1 || age < 0)
+	{
+		*invalid_field = AGE_IDENTIFIER;
+		return NULL;
+	}
+
+	if(read_string(fp, structure_member_prefix[INPUT_FROM_FILE][JOB_IDENTIFIER], job, MAX_JOB_LENGTH) == -1)
+		return NULL;
+	if(job[0] == '\0')
+	{
+		*invalid_field = JOB_IDENTIFIER;
+		return NULL;
+	}
+
+	employee_read = allocate_employee();
+	set_employee_strings(employee_read, name, job);
+	employee_read->sex = sex[0];
+	employee_read->age = age;
+
+	metrics_stop(METRIC_GET_INPUT, &timer);
+	return employee_read;
+}
+
+/*
+	Function: menu_add_employee()
+	Purpose: A function,designed to be called from the menu system, that prompts the user to enter the details of a new employee.
+					 It then places that employee in the correct place (alphabetical order by name field) in the linked list.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The details of new employee.
+	Outputs to user: Prompts for information and error messages (written to stderr).
+									 This function may cause the program to close if there is a memory allocation error when allocating space for the new employee.
+ */
+static void menu_add_employee(void)
+{
+	employee *employee_to_add_ptr;
+
+	employee_to_add_ptr = get_input(stdin, INPUT_FROM_USER);
+
+	place_employee(employee_to_add_ptr);
+
+	return;
+}
+
+/*
+	Function: menu_print_database()
+	Purpose: A function, designed to be called from the menu system, that prints all the employees in the database to stdout.
+					 The employees are printed in alphabetical order, and with prefixes for each field (e.g. Name).
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The details of all the employees in the database, writted to stdout.
+ */
+static void menu_print_database(void)
+{
+	employee *employee_to_print;
+	metrics_timer timer;
+
+	metrics_start(&timer);
+	for(employee_to_print = head; employee_to_print != NULL; employee_to_print = employee_to_print->next)
+	{
+		print_single_employee(stdout, employee_to_print);
+		putchar('\n');
+		employees_visited++;
+	}
+	metrics_stop(METRIC_PRINT, &timer);
+	return;
+}	    
+
+/*
+	Function: menu_delete_employee()
+	Purpose: A function, designed to be called from the menu system, that deletes all the employees with a given name in the database.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The name of the employee(s) to delete
+ */
+static void menu_delete_employee(void)
+{
+	/* Declare a string containing the name of the employee to delete, and a pointer to the employee to delete */
+	char employee_name_to_delete[MAX_NAME_LENGTH + 1];
+	employee *employee_to_delete, *next_employee;
+	
+	/* Prompt the user to enter the name of the employee(s) they would like to delete */
+	fputs("Please enter the name of the employee to be deleted: ", stderr);
+	read_line(stdin, employee_name_to_delete, MAX_NAME_LENGTH);
+	
+	/* Search for the employee to delete */
+	employee_to_delete = search_for_employee(employee_name_to_delete);
+
+	if(employee_to_delete == NULL)
+	{
+		fputs("Employee not found.\n", stderr);
+		return;
+	}
+
+	/* search_for_employee() found the first employee with the name, and any others with the same name are directly after it in the linked list.
+		 So this loop keeps removing employees from there until it reaches one whose name doesn't match the string specified. */
+	do{
+		next_employee = employee_to_delete->next;
+		delete_employee_from_list(employee_to_delete);
+		employee_to_delete = next_employee;
+	} while(employee_to_delete != NULL && strcmp(employee_to_delete->name, employee_name_to_delete) == 0);
+
+	return;
+}
+
+/*
+	Function: read_employee_databases()
+	Purpose: A function, which is run upon starting the program (if database files are specified in the program arguments),
+					 that loads the employees from one or more formatted database files into the database.
+					 The files are read at the same time and merged as they are read, always taking the employee whose name comes first
+					 from the front of the files (as merge_sorted_runs() does), so files that are each in alphabetical order are read in alphabetical order,
+					 and each employee can be linked in straight after the one before.
+					 Files that aren't in order still load correctly, as any employee that doesn't belong after the one before is placed using the skip list.
+					 As with place_employee(), a place metric is recorded for each employee.
+	Arguments: The names of the database files to load (file_names), and the number of them (file_count).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: Relevant error messages (printed to stderr)
+									 The program may exit, if there is a problem with a database file (i.e file not found, or incorrect formatting,
+									 or if there is a problem allocating memory.
+									 A TRACE_PLACE_EMPLOYEE event is recorded for each employee, if tracing is on.
+ */
+static void read_employee_databases(const char *file_names[], int file_count)
+{
+	/* Each file being read, and a heap of the files that have employees left, with the one whose next employee belongs first at the top */
+	sorted_run *inputs, **heap;
+	int heap_size = 0, i, c;
+	metrics_timer timer, place_timer;
+
+	metrics_start(&timer);
+
+	inputs = (sorted_run *)malloc(file_count * sizeof(sorted_run));
+	heap = (sorted_run **)malloc(file_count * sizeof(sorted_run *));
+	if(inputs == NULL || heap == NULL)
+		print_error("Problem allocating memory for loading the database.\nThe program will now exit.\n", DO_EXIT);
+
+	for(i = 0; i < file_count; i++)
+	{
+		/* Attempt to open the file specified by the user */
+		inputs[i].file_pointer = fopen(file_names[i], "r");
+
+		/* If the file pointer is NULL, the file couldn't be opened. */
+		if(inputs[i].file_pointer == NULL)
+			print_error("Error opening database file.\nThe program will now exit.\n", DO_EXIT);
+
+		/* Read the file in large blocks */
+		setvbuf(inputs[i].file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+		/* An empty file is an empty database (menu_save_database() writes one if the database is empty) */
+		c = fgetc(inputs[i].file_pointer);
+		if(c == EOF)
+		{
+			fclose(inputs[i].file_pointer);
+			continue;
+		}
+		ungetc(c, inputs[i].file_pointer);
+
+		inputs[i].number = i;
+		inputs[i].current = get_input(inputs[i].file_pointer, INPUT_FROM_FILE);
+		heap[heap_size++] = &inputs[i];
+	}
+	for(i = heap_size / 2 - 1; i >= 0; i--)
+		sift_down_runs(heap, heap_size, i);
+
+	/* Pointers to employee structures for storing the address of the employee records as they are read from the files,
+		 and the address of the previous employee record that was read. */
+	employee *current_employee_ptr, *last_employee_ptr = NULL;
+	
+	/* The last employee on each level of the skip list before the previous employee record that was read */
+	employee *update[SKIP_LIST_MAX_LEVELS];
+	int level;
+
+	/* Loop through the files, taking each employee from the top of the heap and sorting it into the linked list.
+		 Stop when the end of every file is reached. */
+	while(heap_size > 0)
+	{
+		current_employee_ptr = heap[0]->current;
+
+		/* Replace the employee with the next one from the same file, or take the file off the heap if it is finished */
+		if(end_of_file_test(heap[0]->file_pointer))
+			heap[0]->current = get_input(heap[0]->file_pointer, INPUT_FROM_FILE);
+		else
+		{
+			/* Close the file */
+			fclose(heap[0]->file_pointer);
+			heap[0] = heap[--heap_size];
+		}
+		sift_down_runs(heap, heap_size, 0);
+		
+		/* Database files are usually already in alphabetical order (since menu_print_database() prints them in that order),
+			 so if the employee belongs directly after the previous one, link it in there without searching the skip list.
+			 Nothing can be on any level of the skip list between the two employees, so update[] already holds the right employees for each level. */
+		metrics_start(&place_timer);
+		if(last_employee_ptr == NULL || strcmp(current_employee_ptr->name, last_employee_ptr->name) <= 0
+			 || (last_employee_ptr->next != NULL && strcmp(current_employee_ptr->name, (last_employee_ptr->next)->name) > 0))
+			skip_list_find(current_employee_ptr->name, update);
+
+		/* update[0] is now directly before where the employee belongs (NULL if it is the new head) */
+		TRACE(TRACE_PLACE_EMPLOYEE, current_employee_ptr, update[0], skip_list_next(update[0], 0), 0);
+		link_employee(current_employee_ptr, update);
+		metrics_stop(METRIC_PLACE, &place_timer);
+		
+		/* The current employee is now the last employee before the next position on each of its levels */
+		for(level = 0; level < current_employee_ptr->skip_levels; level++)
+			update[level] = current_employee_ptr;
+		last_employee_ptr = current_employee_ptr;
+	}
+
+	free(inputs);
+	free(heap);
+
+	metrics_stop(METRIC_LOAD, &timer);
+	return;
+}
+
+/*
+	Function: save_employee_database()
+	Purpose: Write every employee in the database to a file, in the same format that read_employee_databases() reads.
+					 The employees are first written to a temporary file (the file name with ".tmp" added), which is flushed to the disk,
+					 and then renamed to the file name given, and the directory holding the file is flushed to the disk so that the rename is kept too.
+					 This means that the file is never left half written if there is a problem.
+	Arguments: The name of the file to save the database to (file_name).
+	Return value: 0 is returned if the database was saved successfully.
+								-1 is returned if there was a problem writing the file (in which case the file is left as it was),
+								or if the directory couldn't be flushed to the disk (in which case the new file is in place, but might not be after a crash).
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int save_employee_database(const char *file_name)
+{
+	FILE *file_pointer;
+	employee *employee_to_save;
+	int failed;
+
+	/* Work out the name of the temporary file */
+	char *temp_file_name = (char *)malloc(strlen(file_name) + sizeof(".tmp"));
+	if(temp_file_name == NULL)
+		return -1;
+	sprintf(temp_file_name, "%s.tmp", file_name);
+
+	file_pointer = fopen(temp_file_name, "w");
+	if(file_pointer == NULL)
+	{
+		free(temp_file_name);
+		return -1;
+	}
+
+	/* Write the file in large blocks, the disk is then only written to (and waited for) when each block is full and at the end */
+	setvbuf(file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	/* Write the employees in the same way as menu_print_database() */
+	for(employee_to_save = head; employee_to_save != NULL; employee_to_save = employee_to_save->next)
+	{
+		print_single_employee(file_pointer, employee_to_save);
+		fputc('\n', file_pointer);
+	}
+
+	/* Make sure everything has reached the disk before replacing the old file */
+	failed = fflush(file_pointer) != 0 || ferror(file_pointer) || fsync(fileno(file_pointer)) != 0;
+	failed = fclose(file_pointer) != 0 || failed;
+
+	if(failed || rename(temp_file_name, file_name) != 0)
+	{
+		remove(temp_file_name);
+		free(temp_file_name);
+		return -1;
+	}
+
+	free(temp_file_name);
+	return sync_parent_directory(file_name);
+}
+
+/*
+	Function: sync_parent_directory()
+	Purpose: Flush the directory holding a file to the disk, so that a file just renamed into it is still there after a crash.
+	Arguments: The name of the file (file_name), whose directory is the part of the name before the last '/' (or the current directory if there isn't one).
+	Return value: 0 is returned if the directory was flushed.
+								-1 is returned if there was a problem opening or flushing it.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int sync_parent_directory(const char *file_name)
+{
+	const char *last_slash = strrchr(file_name, '/');
+	size_t length;
+	char *directory_name;
+	int directory, failed;
+
+	/* Work out the name of the directory, which is "." if the name has no '/' in it, and "/" if the file is in the root directory */
+	if(last_slash == NULL)
+	{
+		file_name = ".";
+		length = 1;
+	}
+	else
+		length = last_slash == file_name ? 1 : (size_t)(last_slash - file_name);
+	directory_name = (char *)malloc(length + 1);
+	if(directory_name == NULL)
+		return -1;
+	memcpy(directory_name, file_name, length);
+	directory_name[length] = '\0';
+
+	directory = open(directory_name, O_RDONLY);
+	free(directory_name);
+	if(directory < 0)
+		return -1;
+
+	failed = fsync(directory) != 0;
+	failed = close(directory) != 0 || failed;
+
+	return failed ? -1 : 0;
+}
+
+/*
+	Function: menu_save_database()
+	Purpose: A function, designed to be called from the menu system, that saves all the employees in the database to a file,
+					 so that changes made to the database are kept the next time the program is run.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The name of the file to save to (or nothing, to save to the database file that was loaded, if only one was).
+	Outputs to user: Prompts and error messages (written to stderr).
+ */
+static void menu_save_database(void)
+{
+	char file_name[MAX_FILE_NAME_LENGTH + 1];
+	const char *file_to_save_to = file_name;
+
+	/* Prompt the user to enter the name of the file to save to */
+	fputs("Please enter the name of the file to save the database to", stderr);
+	if(database_file_name != NULL)
+		fprintf(stderr, " (leave blank to save to %s)", database_file_name);
+	fputs(": ", stderr);
+	if(read_line(stdin, file_name, MAX_FILE_NAME_LENGTH) != 0)
+		return;
+
+	if(file_name[0] == '\0')
+	{
+		if(database_file_name == NULL)
+		{
+			fputs("No file name given, the database has not been saved.\n", stderr);
+			return;
+		}
+		file_to_save_to = database_file_name;
+	}
+
+	if(save_employee_database(file_to_save_to) != 0)
+		fputs("Failed to save database file, the database has not been saved.\n", stderr);
+	else
+		fputs("Database saved.\n", stderr);
+
+	return;
+}
+
+/*
+	Function: match_word()
+	Purpose: Check whether a string starts with a given word (ignoring case), followed by something other than a letter or number.
+					 If it does, the string pointer is moved past the word.
+	Arguments: A pointer to the string pointer to check (text).
+						 The word to check for, in lower case (word).
+	Return value: 1 if the string starts with the word.
+								0 if it doesn't.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int match_word(const char **text, const char *word)
+{
+	int i;
+
+	for(i = 0; word[i] != '\0'; i++)
+		if(tolower((unsigned char)(*text)[i]) != word[i])
+			return 0;
+
+	if(isalnum((unsigned char)(*text)[i]))
+		return 0;
+
+	*text += i;
+	return 1;
+}
+
+/*
+	Function: compile_query()
+	Purpose: Turn the text of a query, such as "age >= 30 AND sex = 'F' AND job = 'Engineer'", into a compiled query.
+					 Each condition is a structure member name (name, sex, age or job), a comparison operator (=, !=, <, <=, > or >=) and a value.
+					 Values can be surrounded by single or double quotes, which is needed if they contain spaces.
+					 The conditions are sorted so that the quickest ones to test come first, and any conditions on the name are used to
+					 work out the range of names that matching employees can be in.
+					 An empty query matches every employee.
+	Arguments: The text of the query (text).
+						 The query structure to store the compiled query in (compiled_query).
+	Return value: 0 is returned if the query was compiled successfully.
+								-1 is returned if the query is invalid.
+	Inputs from user: None.
+	Outputs to user: An error message (printed to stderr) if the query is invalid.
+ */
+static int compile_query(const char *text, query *compiled_query)
+{
+	condition *current_condition, temp_condition;
+	char buffer[2];
+	char quote;
+	int i, j, length;
+
+	compiled_query->condition_count = 0;
+
+	for(;;)
+	{
+		while(isspace((unsigned char)*text))
+			text++;
+
+		/* An empty query has no conditions */
+		if(*text == '\0' && compiled_query->condition_count == 0)
+			break;
+
+		if(compiled_query->condition_count == MAX_QUERY_CONDITIONS)
+		{
+			print_error("Too many conditions in query.\n", DO_NOT_EXIT);
+			return -1;
+		}
+		current_condition = &compiled_query->conditions[compiled_query->condition_count];
+
+		/* Read the structure member name */
+		for(current_condition->field_identifier = 0; current_condition->field_identifier < 4; current_condition->field_identifier++)
+			if(match_word(&text, structure_member_name[current_condition->field_identifier]))
+				break;
+		if(current_condition->field_identifier == 4)
+		{
+			print_error("Query conditions must start with name, sex, age or job.\n", DO_NOT_EXIT);
+			return -1;
+		}
+
+		while(isspace((unsigned char)*text))
+			text++;
+
+		/* Read the comparison operator, checking the two character operators before the one character operators that they start with */
+		for(current_condition->comparison = GREATER_THAN_OR_EQUAL_TO; current_condition->comparison >= EQUAL_TO; current_condition->comparison--)
+			if(strncmp(text, comparison_operator[current_condition->comparison], strlen(comparison_operator[current_condition->comparison])) == 0)
+				break;
+		if(current_condition->comparison < EQUAL_TO)
+		{
+			print_error("Invalid comparison operator in query.\n", DO_NOT_EXIT);
+			return -1;
+		}
+		text += strlen(comparison_operator[current_condition->comparison]);
+
+		while(isspace((unsigned char)*text))
+			text++;
+
+		/* Read the value, which is either in quotes or ends at the next space */
+		length = 0;
+		if(*text == '\'' || *text == '"')
+		{
+			for(quote = *text++; *text != quote; text++)
+			{
+				if(*text == '\0')
+				{
+					print_error("Missing closing quote in query.\n", DO_NOT_EXIT);
+					return -1;
+				}
+				if(length < MAX_CHARS_TO_READ)
+					current_condition->text[length++] = *text;
+			}
+			text++;
+		}else
+			for(; *text != '\0' && !isspace((unsigned char)*text); text++)
+				if(length < MAX_CHARS_TO_READ)
+					current_condition->text[length++] = *text;
+		current_condition->text[length] = '\0';
+
+		/* Check the value is valid for the structure member, using the same rules as get_input() */
+		if(current_condition->field_identifier == AGE_IDENTIFIER
+			 && sscanf(current_condition->text, "%d%1[^\n]", &current_condition->number, buffer) != 1)
+		{
+			print_error("Invalid age in query.\n", DO_NOT_EXIT);
+			return -1;
+		}
+		if(current_condition->field_identifier == SEX_IDENTIFIER)
+		{
+			if(length != 1 || (current_condition->text[0] != 'M' && current_condition->text[0] != 'F'))
+			{
+				print_error("Invalid sex in query.\n", DO_NOT_EXIT);
+				return -1;
+			}
+			current_condition->number = current_condition->text[0];
+		}
+
+		compiled_query->condition_count++;
+
+		/* The query must either end here, or carry on with AND */
+		while(isspace((unsigned char)*text))
+			text++;
+		if(*text == '\0')
+			break;
+		if(!match_word(&text, "and"))
+		{
+			print_error("Query conditions must be joined by AND.\n", DO_NOT_EXIT);
+			return -1;
+		}
+	}
+
+	/* Sort the conditions so that the quickest ones to test come first (using an insertion sort, as there are only a few conditions).
+		 As the conditions are sorted completely, queries that are the same apart from the order of their conditions end up the same. */
+	for(i = 1; i < compiled_query->condition_count; i++)
+	{
+		temp_condition = compiled_query->conditions[i];
+		for(j = i; j > 0 && compare_conditions(&compiled_query->conditions[j-1], &temp_condition) > 0; j--)
+			compiled_query->conditions[j] = compiled_query->conditions[j-1];
+		compiled_query->conditions[j] = temp_condition;
+	}
+
+	/* Work out the narrowest range of names allowed by the conditions on the name */
+	compiled_query->name_from = NULL;
+	compiled_query->name_to = NULL;
+	compiled_query->name_to_inclusive = 1;
+	for(i = 0; i < compiled_query->condition_count; i++)
+	{
+		current_condition = &compiled_query->conditions[i];
+		if(current_condition->field_identifier != NAME_IDENTIFIER || current_condition->comparison == NOT_EQUAL_TO)
+			continue;
+
+		/* Conditions that give a first name (employees before it are skipped) */
+		if(current_condition->comparison != LESS_THAN && current_condition->comparison != LESS_THAN_OR_EQUAL_TO)
+			if(compiled_query->name_from == NULL || strcmp(current_condition->text, compiled_query->name_from) > 0)
+				compiled_query->name_from = current_condition->text;
+
+		/* Conditions that give a last name (the search stops after it) */
+		if(current_condition->comparison != GREATER_THAN && current_condition->comparison != GREATER_THAN_OR_EQUAL_TO)
+			if(compiled_query->name_to == NULL || strcmp(current_condition->text, compiled_query->name_to) < 0
+				 || (strcmp(current_condition->text, compiled_query->name_to) == 0 && current_condition->comparison == LESS_THAN))
+			{
+				compiled_query->name_to = current_condition->text;
+				compiled_query->name_to_inclusive = (current_condition->comparison != LESS_THAN);
+			}
+	}
+	compiled_query->use_name_index = compiled_query->name_from != NULL && compiled_query->name_to != NULL
+																	 && compiled_query->name_to_inclusive && strcmp(compiled_query->name_from, compiled_query->name_to) == 0;
+
+	return 0;
+}
+
+/*
+	Function: condition_is_true()
+	Purpose: Test whether a query condition is true for an employee.
+	Arguments: The condition to test (condition_to_test).
+						 The employee to test it on (employee_to_test).
+	Return value: 1 if the condition is true.
+								0 if it is false.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int condition_is_true(const condition *condition_to_test, const employee *employee_to_test)
+{
+	/* This is < 0 if the employee's value belongs before the condition's value, 0 if they are the same and > 0 if it belongs after */
+	int difference;
+
+	switch(condition_to_test->field_identifier)
+	{
+		case NAME_IDENTIFIER:
+			difference = strcmp(employee_to_test->name, condition_to_test->text);
+			break;
+		case SEX_IDENTIFIER:
+			difference = employee_to_test->sex - condition_to_test->number;
+			break;
+		case AGE_IDENTIFIER:
+			difference = (employee_to_test->age > condition_to_test->number) - (employee_to_test->age < condition_to_test->number);
+			break;
+		default:
+			difference = strcmp(employee_to_test->job, condition_to_test->text);
+			break;
+	}
+
+	switch(condition_to_test->comparison)
+	{
+		case EQUAL_TO:              return difference == 0;
+		case NOT_EQUAL_TO:          return difference != 0;
+		case LESS_THAN:             return difference < 0;
+		case LESS_THAN_OR_EQUAL_TO: return difference <= 0;
+		case GREATER_THAN:          return difference > 0;
+		default:                    return difference >= 0;
+	}
+}
+
+/*
+	Function: query_match_from()
+	Purpose: Find the first employee matching a compiled query, starting from a given employee and following the linked list.
+					 The search stops once the employees are past the last name allowed by the query.
+	Arguments: The compiled query (compiled_query).
+						 The employee to start from (current_record), which may be NULL.
+	Return value: A pointer to the first matching employee, or NULL if there are no more matching employees.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *query_match_from(const query *compiled_query, employee *current_record)
+{
+	int difference;
+
+	for(; current_record != NULL; current_record = current_record->next)
+	{
+		/* Stop if the employee is past the last name allowed */
+		if(compiled_query->name_to != NULL)
+		{
+			difference = strcmp(current_record->name, compiled_query->name_to);
+			if(difference > 0 || (difference == 0 && !compiled_query->name_to_inclusive))
+				return NULL;
+		}
+
+		if(conditions_are_true(compiled_query->conditions, compiled_query->condition_count, current_record))
+			return current_record;
+	}
+
+	return NULL;
+}
+
+/*
+	Function: query_first()
+	Purpose: Find the first employee (in alphabetical order) matching a compiled query.
+					 If the query is for a single name, the name index is used to find the first employee with that name.
+					 If the query has a first name, the skip list is used to skip the employees before it.
+					 Otherwise every employee from the head of the linked list is tested.
+	Arguments: The compiled query (compiled_query).
+	Return value: A pointer to the first matching employee, or NULL if there are no matching employees.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *query_first(const query *compiled_query)
+{
+	if(compiled_query->use_name_index)
+		return query_match_from(compiled_query, search_for_employee(compiled_query->name_from));
+	if(compiled_query->name_from != NULL)
+		return query_match_from(compiled_query, skip_list_next(skip_list_find(compiled_query->name_from, NULL), 0));
+	return query_match_from(compiled_query, head);
+}
+
+/*
+	Function: query_next()
+	Purpose: Find the next employee (in alphabetical order) matching a compiled query, after one returned by query_first() or query_next().
+	Arguments: The compiled query (compiled_query).
+						 The previous matching employee (current_record).
+	Return value: A pointer to the next matching employee, or NULL if there are no more matching employees.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *query_next(const query *compiled_query, const employee *current_record)
+{
+	return query_match_from(compiled_query, current_record->next);
+}
+
+/*
+	Function: menu_search_database()
+	Purpose: A function, designed to be called from the menu system, that prompts the user for a query
+					 (e.g. age >= 30 AND sex = 'F' AND job = 'Engineer') and prints all the employees that match it to stdout.
+					 The employees are printed in alphabetical order, in the same format as menu_print_database().
+					 The results of recent queries are remembered (see query_cache_entry_struct), so repeating a query doesn't search the database again.
+					 For a large database, queries that have to look at every employee are split between several threads.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The query.
+	Outputs to user: The details of the matching employees, written to stdout.
+									 The number of matching employees, or an error message if the query is invalid (written to stderr).
+									 The fact that the program may terminate if there is a problem allocating memory to remember the result.
+ */
+static void menu_search_database(void)
+{
+	char query_text[MAX_CHARS_TO_READ + 1];
+	query compiled_query;
+	query_cache_entry *cached;
+	employee *employee_to_print;
+	employee **results = NULL;
+	int count = 0, space = 0, i;
+
+	/* Prompt the user to enter the query */
+	fputs("Please enter the query (e.g. age >= 30 AND sex = 'F' AND job = 'Engineer'): ", stderr);
+	if(read_line(stdin, query_text, MAX_CHARS_TO_READ) != 0 || compile_query(query_text, &compiled_query) != 0)
+		return;
+
+	/* If the result of the query is remembered, print it without searching */
+	cached = find_cached_query(&compiled_query);
+	if(cached != NULL)
+	{
+		for(i = 0; i < cached->result_count; i++)
+		{
+			print_single_employee(stdout, cached->results[i]);
+			putchar('\n');
+		}
+		fprintf(stderr, "%d employee(s) found.\n", cached->result_count);
+		return;
+	}
+
+	/* Large searches of every employee are split between several threads, and the results printed in order */
+	if(can_scan_in_parallel(&compiled_query))
+	{
+		parallel_scan scan;
+		scan_partition *partition;
+
+		run_parallel_scan(&scan, &compiled_query, SCAN_FOR_RESULTS);
+		for(partition = scan.partitions; partition < scan.partitions + scan.partition_count; partition++)
+			for(i = 0; i < partition->result_count; i++)
+			{
+				print_single_employee(stdout, partition->results[i]);
+				putchar('\n');
+				add_query_result(&results, &space, count++, partition->results[i]);
+			}
+		free_parallel_scan(&scan);
+	}else
+	{
+		/* Otherwise search, remembering the employees found in case the same query is used again */
+		for(employee_to_print = query_first(&compiled_query); employee_to_print != NULL; employee_to_print = query_next(&compiled_query, employee_to_print))
+		{
+			print_single_employee(stdout, employee_to_print);
+			putchar('\n');
+			add_query_result(&results, &space, count++, employee_to_print);
+		}
+	}
+
+	/* Results that are too large to remember aren't cached */
+	if(count <= QUERY_CACHE_MAX_RESULTS)
+		cache_query_results(&compiled_query, results, count);
+	else
+		free(results);
+
+	fprintf(stderr, "%d employee(s) found.\n", count);
+	return;
+}
+
+/*
+	Function: compare_conditions()
+	Purpose: Compare two query conditions, to put the conditions of a query in order.
+					 Conditions are ordered by how quickly they can be tested, then by comparison operator and then by value.
+	Arguments: The two conditions to compare (first and second).
+	Return value: < 0 if the first condition belongs before the second, 0 if they are the same, > 0 if the first condition belongs after the second.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_conditions(const condition *first, const condition *second)
+{
+	if(first->field_identifier != second->field_identifier)
+		return condition_cost[first->field_identifier] - condition_cost[second->field_identifier];
+	if(first->comparison != second->comparison)
+		return first->comparison - second->comparison;
+
+	/* The values of sex and age conditions are compared as numbers, so that e.g. "age = 30" and "age = 030" are the same */
+	if(first->field_identifier == SEX_IDENTIFIER || first->field_identifier == AGE_IDENTIFIER)
+		return (first->number > second->number) - (first->number < second->number);
+	return strcmp(first->text, second->text);
+}
+
+/*
+	Function: conditions_are_true()
+	Purpose: Test whether every one of a list of query conditions is true for an employee, stopping at the first one that is false.
+	Arguments: The conditions to test (conditions), and the number of them (condition_count).
+						 The employee to test them on (employee_to_test).
+	Return value: 1 if all the conditions are true.
+								0 if any of them are false.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int conditions_are_true(const condition conditions[], int condition_count, const employee *employee_to_test)
+{
+	int i;
+
+	for(i = 0; i < condition_count; i++)
+		if(!condition_is_true(&conditions[i], employee_to_test))
+			return 0;
+	return 1;
+}
+
+/*
+	Function: find_cached_query()
+	Purpose: Look for a remembered result for a query in the query cache.
+	Arguments: The compiled query (compiled_query).
+	Return value: A pointer to the cache entry holding the result, or NULL if the result isn't remembered.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static query_cache_entry *find_cached_query(const query *compiled_query)
+{
+	query_cache_entry *entry;
+	int i;
+
+	for(entry = query_cache; entry < query_cache + QUERY_CACHE_ENTRIES; entry++)
+	{
+		if(!entry->in_use || entry->condition_count != compiled_query->condition_count)
+			continue;
+
+		for(i = 0; i < entry->condition_count; i++)
+			if(compare_conditions(&entry->conditions[i], &compiled_query->conditions[i]) != 0)
+				break;
+
+		if(i == entry->condition_count)
+		{
+			entry->last_used = ++query_cache_clock;
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+	Function: cache_query_results()
+	Purpose: Remember the result of a query in the query cache, replacing the entry that was used longest ago if the cache is full.
+	Arguments: The compiled query (compiled_query).
+						 Pointers to the employees that matched (results), and the number of them (result_count).
+							The array must have been allocated with malloc() (or be NULL if there are no results), and is kept by the cache, which frees it.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void cache_query_results(const query *compiled_query, employee *results[], int result_count)
+{
+	query_cache_entry *entry, *oldest_entry = query_cache;
+
+	for(entry = query_cache; entry < query_cache + QUERY_CACHE_ENTRIES; entry++)
+		if(!entry->in_use || entry->last_used < oldest_entry->last_used)
+		{
+			oldest_entry = entry;
+			if(!entry->in_use)
+				break;
+		}
+	entry = oldest_entry;
+
+	free(entry->results);
+	entry->results = results;
+
+	entry->in_use = 1;
+	entry->last_used = ++query_cache_clock;
+	entry->condition_count = compiled_query->condition_count;
+	memcpy(entry->conditions, compiled_query->conditions, compiled_query->condition_count * sizeof(condition));
+	entry->result_count = result_count;
+
+	return;
+}
+
+/*
+	Function: add_query_result()
+	Purpose: Add an employee that matched a query to the array of results being collected for cache_query_results(),
+					 making the array bigger (doubling it) when needed. Nothing is added once there are more results than can be remembered.
+	Arguments: A pointer to the array of results (results), which starts as NULL.
+						 A pointer to the number of results there is room for in the array (space), which starts as 0.
+						 The number of results before this one (count).
+						 The employee that matched (result).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void add_query_result(employee ***results, int *space, int count, employee *result)
+{
+	if(count >= QUERY_CACHE_MAX_RESULTS)
+		return;
+
+	if(count == *space)
+	{
+		*space = *space == 0 ? 64 : *space * 2;
+		if(*space > QUERY_CACHE_MAX_RESULTS)
+			*space = QUERY_CACHE_MAX_RESULTS;
+		*results = (employee **)realloc(*results, *space * sizeof(employee *));
+		if(*results == NULL)
+			print_error("Problem allocating memory for remembering a query result.\nThe program will now exit.\n", DO_EXIT);
+	}
+	(*results)[count] = result;
+
+	return;
+}
+
+/*
+	Function: invalidate_query_cache()
+	Purpose: Throw away the remembered results of any queries that an employee matches, because that employee is being added, deleted or changed.
+					 Results of queries that the employee doesn't match are kept, as they are not affected.
+	Arguments: The employee that is changing (changed_employee).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void invalidate_query_cache(const employee *changed_employee)
+{
+	query_cache_entry *entry;
+
+	for(entry = query_cache; entry < query_cache + QUERY_CACHE_ENTRIES; entry++)
+		if(entry->in_use && conditions_are_true(entry->conditions, entry->condition_count, changed_employee))
+		{
+			entry->in_use = 0;
+			free(entry->results);
+			entry->results = NULL;
+		}
+
+	return;
+}
+
+/*
+	Function: find_job_group()
+	Purpose: Find the group for a job and sex in a job group hash table, creating a new (empty) group if there isn't one already.
+	Arguments: The hash table, an array of JOB_GROUP_BUCKETS pointers (table).
+						 A pointer to the number of groups in the table, which is increased if a new group is created (group_count).
+						 The job and sex of the group to find (job and sex).
+	Return value: A pointer to the group.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for a new group.
+ */
+static job_group *find_job_group(job_group *table[], int *group_count, const char *job, char sex)
+{
+	job_group **bucket = &table[(hash_name(job) ^ (unsigned char)sex) % JOB_GROUP_BUCKETS];
+	job_group *group;
+
+	for(group = *bucket; group != NULL; group = group->bucket_next)
+		if(group->sex == sex && strcmp(group->job, job) == 0)
+			return group;
+
+	/* The group doesn't exist yet, so create it at the start of the bucket */
+	group = (job_group *)malloc(sizeof(job_group));
+	if(group == NULL)
+		print_error("Problem allocating memory for the job report.\nThe program will now exit.\n", DO_EXIT);
+
+	strcpy(group->job, job);
+	group->sex = sex;
+	group->count = 0;
+	group->total_age = 0;
+	group->ages_stale = 0;
+	group->bucket_next = *bucket;
+	*bucket = group;
+	(*group_count)++;
+
+	return group;
+}
+
+/*
+	Function: add_to_job_group()
+	Purpose: Add an employee's age to the figures for a job group.
+	Arguments: The group to add to (group).
+						 The age of the employee (age).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void add_to_job_group(job_group *group, int age)
+{
+	if(group->count == 0 || age < group->min_age)
+		group->min_age = age;
+	if(group->count == 0 || age > group->max_age)
+		group->max_age = age;
+	group->count++;
+	group->total_age += age;
+	return;
+}
+
+/*
+	Function: compare_job_groups()
+	Purpose: Compare two job groups for qsort(), so that the groups are sorted alphabetically by job,
+					 with the group for all the employees with a job first, followed by the groups for each sex.
+	Arguments: Pointers to the two pointers to job groups to compare (first and second).
+	Return value: < 0 if the first group belongs before the second, 0 if they are the same, > 0 if the first group belongs after the second.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_job_groups(const void *first, const void *second)
+{
+	const job_group *first_group = *(const job_group * const *)first;
+	const job_group *second_group = *(const job_group * const *)second;
+	int difference = strcmp(first_group->job, second_group->job);
+
+	/* ALL_SEXES comes before 'F' and 'M' */
+	if(difference == 0)
+		difference = first_group->sex - second_group->sex;
+	return difference;
+}
+
+/*
+	Function: print_job_report()
+	Purpose: Print the figures for every group in a job group hash table to stdout, sorted by job.
+	Arguments: The hash table, an array of JOB_GROUP_BUCKETS pointers (table).
+						 The number of groups in the table (group_count).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The job report, written to stdout.
+									 The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void print_job_report(job_group *table[], int group_count)
+{
+	job_group **groups, *group;
+	int i, j;
+
+	/* Gather the groups into an array so that they can be sorted */
+	groups = (job_group **)malloc((group_count + 1) * sizeof(job_group *));
+	if(groups == NULL)
+		print_error("Problem allocating memory for the job report.\nThe program will now exit.\n", DO_EXIT);
+	for(i = 0, j = 0; i < JOB_GROUP_BUCKETS; i++)
+		for(group = table[i]; group != NULL; group = group->bucket_next)
+			groups[j++] = group;
+	qsort(groups, group_count, sizeof(job_group *), compare_job_groups);
+
+	printf("%-30s %-4s %8s %8s %8s %8s\n", "Job", "Sex", "Count", "Min age", "Max age", "Avg age");
+	for(i = 0; i < group_count; i++)
+	{
+		group = groups[i];
+		if(group->sex == ALL_SEXES)
+			printf("%-30s %-4s %8d %8d %8d %8.1f\n", group->job, "All", group->count, group->min_age, group->max_age, group->total_age / group->count);
+		else
+			printf("%-30s %-4c %8d %8d %8d %8.1f\n", "", group->sex, group->count, group->min_age, group->max_age, group->total_age / group->count);
+	}
+
+	free(groups);
+	return;
+}
+
+/*
+	Function: menu_print_job_report()
+	Purpose: A function, designed to be called from the menu system, that prints the number of employees and their youngest, oldest and average ages
+					 for each job, both for all the employees with that job and split by sex.
+					 The figures for the whole database are kept up to date as employees are added and deleted, so are printed without looking at the employees.
+					 The user can enter a query (in the same form as for menu_search_database()) to only include some employees,
+					 in which case the figures are worked out in a single pass over those employees, grouping them with a hash table keyed on job and sex.
+					 (For a large database, the pass is split between several threads if the query has to look at every employee.)
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The query (or nothing, to include every employee).
+	Outputs to user: The job report, written to stdout.
+									 An error message if the query is invalid (written to stderr).
+ */
+static void menu_print_job_report(void)
+{
+	char query_text[MAX_CHARS_TO_READ + 1];
+	query compiled_query;
+	job_group *table[JOB_GROUP_BUCKETS] = {NULL};
+	employee *current_record;
+	int group_count = 0;
+
+	/* Prompt the user to enter the query */
+	fputs("Please enter a query to choose the employees to include (leave blank to include all employees): ", stderr);
+	if(read_line(stdin, query_text, MAX_CHARS_TO_READ) != 0 || compile_query(query_text, &compiled_query) != 0)
+		return;
+
+	/* With no conditions, the figures that are kept up to date can be printed straight away */
+	if(compiled_query.condition_count == 0)
+	{
+		refresh_job_group_view();
+		print_job_report(job_group_view, job_group_view_count);
+		return;
+	}
+
+	/* Large scans of every employee are split between several threads, and the groups found by each one combined */
+	if(can_scan_in_parallel(&compiled_query))
+	{
+		parallel_scan scan;
+		scan_partition *partition;
+		job_group *group;
+		int i;
+
+		run_parallel_scan(&scan, &compiled_query, SCAN_FOR_JOB_GROUPS);
+		for(partition = scan.partitions; partition < scan.partitions + scan.partition_count; partition++)
+			for(i = 0; i < JOB_GROUP_BUCKETS; i++)
+				for(group = partition->groups[i]; group != NULL; group = group->bucket_next)
+					merge_job_group(table, &group_count, group);
+		free_parallel_scan(&scan);
+	}else
+	{
+		for(current_record = query_first(&compiled_query); current_record != NULL; current_record = query_next(&compiled_query, current_record))
+		{
+			add_to_job_group(find_job_group(table, &group_count, current_record->job, ALL_SEXES), current_record->age);
+			add_to_job_group(find_job_group(table, &group_count, current_record->job, current_record->sex), current_record->age);
+		}
+	}
+
+	print_job_report(table, group_count);
+	free_job_groups(table);
+	return;
+}
+
+/*
+	Function: free_job_groups()
+	Purpose: Free every group in a job group hash table.
+	Arguments: The hash table, an array of JOB_GROUP_BUCKETS pointers (table).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void free_job_groups(job_group *table[])
+{
+	job_group *group, *next_group;
+	int i;
+
+	for(i = 0; i < JOB_GROUP_BUCKETS; i++)
+		for(group = table[i]; group != NULL; group = next_group)
+		{
+			next_group = group->bucket_next;
+			free(group);
+		}
+	return;
+}
+
+/*
+	Function: remove_from_job_group()
+	Purpose: Remove an employee's age from the figures for a job group, and remove the group from its hash table if it is now empty.
+					 If the age was the youngest or oldest in the group, the group is marked as needing its ages working out again
+					 (this is done by refresh_job_group_view() when the figures are next printed).
+	Arguments: The hash table that the group is in, an array of JOB_GROUP_BUCKETS pointers (table).
+						 A pointer to the number of groups in the table, which is reduced if the group is removed (group_count).
+						 The group to remove from (group).
+						 The age of the employee (age).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void remove_from_job_group(job_group *table[], int *group_count, job_group *group, int age)
+{
+	job_group **link;
+
+	group->count--;
+	group->total_age -= age;
+
+	if(group->count > 0)
+	{
+		if(age == group->min_age || age == group->max_age)
+		{
+			group->ages_stale = 1;
+			job_group_view_stale = 1;
+		}
+		return;
+	}
+
+	/* The group is empty, so find the pointer that points to it and make it point to the group after it in the bucket instead */
+	for(link = &table[(hash_name(group->job) ^ (unsigned char)group->sex) % JOB_GROUP_BUCKETS]; *link != group; link = &((*link)->bucket_next))
+		;
+	*link = group->bucket_next;
+	(*group_count)--;
+	free(group);
+
+	return;
+}
+
+/*
+	Function: add_to_views()
+	Purpose: Update the figures kept about the whole database (the head counts, age histogram and job groups) for an employee that has been added.
+	Arguments: The employee that has been added (employee_to_add).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for a new job group.
+ */
+static void add_to_views(const employee *employee_to_add)
+{
+	int bucket = employee_to_add->age / AGE_HISTOGRAM_WIDTH;
+
+	employee_count++;
+	if(employee_to_add->sex == 'M')
+		male_count++;
+	else
+		female_count++;
+	age_histogram[bucket < AGE_HISTOGRAM_BUCKETS ? bucket : AGE_HISTOGRAM_BUCKETS - 1]++;
+
+	add_to_job_group(find_job_group(job_group_view, &job_group_view_count, employee_to_add->job, ALL_SEXES), employee_to_add->age);
+	add_to_job_group(find_job_group(job_group_view, &job_group_view_count, employee_to_add->job, employee_to_add->sex), employee_to_add->age);
+
+	return;
+}
+
+/*
+	Function: remove_from_views()
+	Purpose: Update the figures kept about the whole database (the head counts, age histogram and job groups) for an employee that is being deleted.
+	Arguments: The employee that is being deleted (employee_to_remove).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void remove_from_views(const employee *employee_to_remove)
+{
+	int bucket = employee_to_remove->age / AGE_HISTOGRAM_WIDTH;
+
+	employee_count--;
+	if(employee_to_remove->sex == 'M')
+		male_count--;
+	else
+		female_count--;
+	age_histogram[bucket < AGE_HISTOGRAM_BUCKETS ? bucket : AGE_HISTOGRAM_BUCKETS - 1]--;
+
+	remove_from_job_group(job_group_view, &job_group_view_count,
+												find_job_group(job_group_view, &job_group_view_count, employee_to_remove->job, ALL_SEXES), employee_to_remove->age);
+	remove_from_job_group(job_group_view, &job_group_view_count,
+												find_job_group(job_group_view, &job_group_view_count, employee_to_remove->job, employee_to_remove->sex), employee_to_remove->age);
+
+	return;
+}
+
+/*
+	Function: refresh_job_group_view()
+	Purpose: Work out the youngest and oldest ages again for any job groups in job_group_view that need it (because the youngest or oldest
+					 employee in the group was deleted). This takes a single pass over the employees, and is only needed after such a deletion.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void refresh_job_group_view(void)
+{
+	employee *current_record;
+	job_group *group;
+	int i;
+
+	if(!job_group_view_stale)
+		return;
+
+	for(current_record = head; current_record != NULL; current_record = current_record->next)
+		for(i = 0; i < 2; i++)
+		{
+			group = find_job_group(job_group_view, &job_group_view_count, current_record->job, i == 0 ? ALL_SEXES : current_record->sex);
+
+			/* ages_stale is 1 before the first employee in the group is seen, and 2 after */
+			if(group->ages_stale == 1)
+			{
+				group->min_age = group->max_age = current_record->age;
+				group->ages_stale = 2;
+			}else if(group->ages_stale == 2)
+			{
+				if(current_record->age < group->min_age)
+					group->min_age = current_record->age;
+				if(current_record->age > group->max_age)
+					group->max_age = current_record->age;
+			}
+		}
+
+	for(i = 0; i < JOB_GROUP_BUCKETS; i++)
+		for(group = job_group_view[i]; group != NULL; group = group->bucket_next)
+			group->ages_stale = 0;
+	job_group_view_stale = 0;
+
+	return;
+}
+
+/*
+	Function: menu_print_summary()
+	Purpose: A function, designed to be called from the menu system, that prints the number of employees in the database,
+					 the number of each sex, and a histogram of their ages.
+					 These figures are kept up to date as employees are added and deleted, so are printed without looking at the employees.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The summary, written to stdout.
+ */
+static void menu_print_summary(void)
+{
+	int i;
+
+	printf("Employees: %d\n", employee_count);
+	printf("Male: %d\n", male_count);
+	printf("Female: %d\n", female_count);
+
+	for(i = 0; i < AGE_HISTOGRAM_BUCKETS - 1; i++)
+		printf("Age %d-%d: %d\n", i * AGE_HISTOGRAM_WIDTH, (i + 1) * AGE_HISTOGRAM_WIDTH - 1, age_histogram[i]);
+	printf("Age %d+: %d\n", i * AGE_HISTOGRAM_WIDTH, age_histogram[i]);
+
+	return;
+}
+
+/*
+	Function: ranks_before()
+	Purpose: Decide whether one employee belongs before another when sorting by age.
+					 Employees with the same age are kept in alphabetical order.
+	Arguments: The two employees to compare (first and second).
+						 An integer determining whether older employees come first (oldest_first), evaluated as TRUE or FALSE.
+	Return value: 1 if the first employee belongs before the second.
+								0 if it doesn't.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int ranks_before(const ranked_employee *first, const ranked_employee *second, int oldest_first)
+{
+	if(first->record->age != second->record->age)
+		return oldest_first ? first->record->age > second->record->age : first->record->age < second->record->age;
+	return first->position < second->position;
+}
+
+/*
+	Function: sift_down()
+	Purpose: Move an element of a heap down until neither of the elements below it belong after it,
+					 so that the element at the top of the heap is always the one that belongs last.
+	Arguments: The heap (heap), and the number of elements in it (heap_size).
+						 The index of the element to move down (i).
+						 An integer determining whether older employees come first (oldest_first), evaluated as TRUE or FALSE.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void sift_down(ranked_employee heap[], int heap_size, int i, int oldest_first)
+{
+	ranked_employee temp;
+	int last, child;
+
+	for(;;)
+	{
+		/* Find which of the element and the two below it belongs last */
+		last = i;
+		for(child = 2 * i + 1; child <= 2 * i + 2 && child < heap_size; child++)
+			if(ranks_before(&heap[last], &heap[child], oldest_first))
+				last = child;
+
+		if(last == i)
+			return;
+
+		temp = heap[i];
+		heap[i] = heap[last];
+		heap[last] = temp;
+		i = last;
+	}
+}
+
+/*
+	Function: top_employees_by_age()
+	Purpose: Find the first few employees matching a query, when they are put in order of age, in a single pass over the matching employees.
+					 A heap holds the best employees found so far, with the one that belongs last at the top, so each new employee only needs
+					 comparing with the top of the heap. At the end the heap is sorted into order.
+	Arguments: The compiled query (compiled_query).
+						 An array to store the employees in (heap), which must have room for count elements.
+						 The number of employees to find (count).
+						 An integer determining whether older employees come first (oldest_first), evaluated as TRUE or FALSE.
+	Return value: The number of employees found (which is less than count if fewer employees match the query).
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int top_employees_by_age(const query *compiled_query, ranked_employee heap[], int count, int oldest_first)
+{
+	ranked_employee candidate, temp;
+	employee *current_record;
+	int heap_size = 0, i;
+
+	for(current_record = query_first(compiled_query), candidate.position = 0; current_record != NULL;
+			current_record = query_next(compiled_query, current_record), candidate.position++)
+	{
+		candidate.record = current_record;
+
+		if(heap_size < count)
+		{
+			/* The heap isn't full yet, so add the employee at the bottom and move it up to its place */
+			for(i = heap_size++; i > 0 && ranks_before(&heap[(i - 1) / 2], &candidate, oldest_first); i = (i - 1) / 2)
+				heap[i] = heap[(i - 1) / 2];
+			heap[i] = candidate;
+		}else if(ranks_before(&candidate, &heap[0], oldest_first))
+		{
+			/* The employee belongs before the last of the best employees so far, so replace it */
+			heap[0] = candidate;
+			sift_down(heap, heap_size, 0, oldest_first);
+		}
+	}
+
+	/* Sort the heap, by repeatedly moving the employee that belongs last to the end */
+	for(i = heap_size - 1; i > 0; i--)
+	{
+		temp = heap[0];
+		heap[0] = heap[i];
+		heap[i] = temp;
+		sift_down(heap, i, 0, oldest_first);
+	}
+
+	return heap_size;
+}
+
+/*
+	Function: sort_by_age()
+	Purpose: Sort an array of pointers to employees (which are in alphabetical order) into order of age, keeping employees with the same age in alphabetical order.
+					 A radix sort is used, sorting on one byte of the age at a time, which needs only one pass for ages under 256.
+	Arguments: The array of pointers to sort (records), and the number of pointers in it (count).
+						 An integer determining whether older employees come first (oldest_first), evaluated as TRUE or FALSE.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void sort_by_age(employee *records[], int count, int oldest_first)
+{
+	employee **sorted;
+	int bucket_start[256];
+	int i, digit, shift, max_age = 0, total;
+
+	for(i = 0; i < count; i++)
+		if(records[i]->age > max_age)
+			max_age = records[i]->age;
+
+	sorted = (employee **)malloc((count + 1) * sizeof(employee *));
+	if(sorted == NULL)
+		print_error("Problem allocating memory for sorting employees.\nThe program will now exit.\n", DO_EXIT);
+
+	/* Sort on each byte of the age, starting with the lowest, stopping once every higher byte is 0 */
+	for(shift = 0; shift == 0 || (shift < 32 && (max_age >> shift) != 0); shift += 8)
+	{
+		/* Count the employees with each value of this byte */
+		for(digit = 0; digit < 256; digit++)
+			bucket_start[digit] = 0;
+		for(i = 0; i < count; i++)
+			bucket_start[(records[i]->age >> shift) & 0xFF]++;
+
+		/* Work out where each value starts in the sorted array, going from the highest value for oldest first */
+		for(digit = 0, total = 0; digit < 256; digit++)
+		{
+			int value = oldest_first ? 255 - digit : digit;
+			int value_count = bucket_start[value];
+			bucket_start[value] = total;
+			total += value_count;
+		}
+
+		/* Move the pointers to their places, in order, so that the order from the previous bytes is kept */
+		for(i = 0; i < count; i++)
+			sorted[bucket_start[(records[i]->age >> shift) & 0xFF]++] = records[i];
+
+		/* Copy the pointers back into records[], ready for the next pass */
+		for(i = 0; i < count; i++)
+			records[i] = sorted[i];
+	}
+	free(sorted);
+
+	return;
+}
+
+/*
+	Function: menu_print_by_age()
+	Purpose: A function, designed to be called from the menu system, that prints employees matching a query in order of age (e.g. the 100 oldest employees,
+					 or all the engineers from youngest to oldest). Employees with the same age are printed in alphabetical order.
+					 If a number of employees is given, a heap is used to find them in a single pass. Otherwise every matching employee is sorted with a radix sort.
+					 In both cases only pointers to the employees are sorted.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The query (or nothing, to include every employee), the number of employees to print and whether to print the oldest first.
+	Outputs to user: The details of the employees, written to stdout.
+									 Prompts and error messages (written to stderr).
+ */
+static void menu_print_by_age(void)
+{
+	char line[MAX_CHARS_TO_READ + 1], buffer[2];
+	query compiled_query;
+	ranked_employee *heap;
+	employee **records, *current_record;
+	int count, found, oldest_first, i;
+
+	fputs("Please enter a query to choose the employees to include (leave blank to include all employees): ", stderr);
+	if(read_line(stdin, line, MAX_CHARS_TO_READ) != 0 || compile_query(line, &compiled_query) != 0)
+		return;
+
+	fputs("Please enter the number of employees to print (leave blank to print all of them): ", stderr);
+	if(read_line(stdin, line, MAX_CHARS_TO_READ) != 0)
+		return;
+	if(line[0] == '\0')
+		count = 0;
+	else if(sscanf(line, "%d%1[^\n]", &count, buffer) != 1 || count <= 0)
+	{
+		fputs("Invalid number of employees.\n", stderr);
+		return;
+	}
+
+	fputs("Print the oldest employees first? (Y/N): ", stderr);
+	if(read_line(stdin, line, MAX_CHARS_TO_READ) != 0)
+		return;
+	oldest_first = (line[0] == 'Y' || line[0] == 'y');
+
+	if(count > 0 && count < employee_count)
+	{
+		heap = (ranked_employee *)malloc(count * sizeof(ranked_employee));
+		if(heap == NULL)
+			print_error("Problem allocating memory for sorting employees.\nThe program will now exit.\n", DO_EXIT);
+
+		found = top_employees_by_age(&compiled_query, heap, count, oldest_first);
+		for(i = 0; i < found; i++)
+		{
+			print_single_employee(stdout, heap[i].record);
+			putchar('\n');
+		}
+
+		free(heap);
+		return;
+	}
+
+	/* Every matching employee is needed, so gather them (there can't be more than employee_count of them) and sort them */
+	records = (employee **)malloc((employee_count + 1) * sizeof(employee *));
+	if(records == NULL)
+		print_error("Problem allocating memory for sorting employees.\nThe program will now exit.\n", DO_EXIT);
+
+	for(current_record = query_first(&compiled_query), found = 0; current_record != NULL; current_record = query_next(&compiled_query, current_record))
+		records[found++] = current_record;
+	sort_by_age(records, found, oldest_first);
+
+	for(i = 0; i < found; i++)
+	{
+		print_single_employee(stdout, records[i]);
+		putchar('\n');
+	}
+
+	free(records);
+	return;
+}
+
+/*
+	Function: cursor_first()
+	Purpose: Find the first employee after a cursor, using the skip list to find the employees with the cursor's name.
+	Arguments: The cursor (position).
+	Return value: A pointer to the first employee after the cursor, or NULL if there are no employees after it.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static employee *cursor_first(const cursor *position)
+{
+	employee *current_record = skip_list_next(skip_list_find(position->name, NULL), 0);
+
+	/* Skip the employees with the cursor's name that are before it, i.e those with an id at least as high as the cursor's */
+	while(current_record != NULL && current_record->id >= position->id && strcmp(current_record->name, position->name) == 0)
+		current_record = current_record->next;
+
+	return current_record;
+}
+
+/*
+	Function: print_page()
+	Purpose: Print the employees after a cursor to stdout, and move the cursor to after the last employee printed.
+					 This takes O(log n) to find the first employee, plus the time to print the page, however far through the database the cursor is.
+	Arguments: The cursor (position).
+						 The maximum number of employees to print (page_size).
+	Return value: The number of employees printed.
+	Inputs from user: None.
+	Outputs to user: The details of the employees, written to stdout.
+ */
+static int print_page(cursor *position, int page_size)
+{
+	employee *current_record, *last_record = NULL;
+	int count;
+
+	for(current_record = cursor_first(position), count = 0; current_record != NULL && count < page_size; current_record = current_record->next, count++)
+	{
+		print_single_employee(stdout, current_record);
+		putchar('\n');
+		last_record = current_record;
+	}
+
+	if(last_record != NULL)
+	{
+		strcpy(position->name, last_record->name);
+		position->id = last_record->id;
+	}
+
+	return count;
+}
+
+/*
+	Function: menu_print_pages()
+	Purpose: A function, designed to be called from the menu system, that prints the employees in the database to stdout a page at a time,
+					 starting either from the beginning of the database or from a given name.
+					 Each page carries on from a cursor left by the previous page, rather than walking the database from the start.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The number of employees on each page, the name to start from and whether to print each next page.
+	Outputs to user: The details of the employees, written to stdout.
+									 Prompts and error messages (written to stderr).
+ */
+static void menu_print_pages(void)
+{
+	char line[MAX_CHARS_TO_READ + 1], buffer[2];
+	cursor position;
+	int page_size;
+
+	fprintf(stderr, "Please enter the number of employees on each page (leave blank for %d): ", DEFAULT_PAGE_SIZE);
+	if(read_line(stdin, line, MAX_CHARS_TO_READ) != 0)
+		return;
+	if(line[0] == '\0')
+		page_size = DEFAULT_PAGE_SIZE;
+	else if(sscanf(line, "%d%1[^\n]", &page_size, buffer) != 1 || page_size <= 0)
+	{
+		fputs("Invalid number of employees.\n", stderr);
+		return;
+	}
+
+	/* The cursor starts before every employee with the name given (an empty name is before every employee) */
+	fputs("Please enter the name to start from (leave blank to start from the beginning): ", stderr);
+	if(read_line(stdin, position.name, MAX_NAME_LENGTH) != 0)
+		return;
+	position.id = ULONG_MAX;
+
+	for(;;)
+	{
+		if(print_page(&position, page_size) < page_size)
+		{
+			fputs("End of database.\n", stderr);
+			return;
+		}
+		fflush(stdout);
+
+		fputs("Press enter to print the next page, or enter Q to stop: ", stderr);
+		if(read_line(stdin, line, MAX_CHARS_TO_READ) != 0 || line[0] == 'Q' || line[0] == 'q')
+			return;
+	}
+}
+
+/*
+	Function: can_scan_in_parallel()
+	Purpose: Decide whether a query should be run on several threads, which is only worthwhile if it has to look at every employee
+					 (i.e it has no conditions on the name that narrow it down) and the database is large.
+	Arguments: The compiled query (compiled_query).
+	Return value: 1 if the query should be run on several threads.
+								0 if it shouldn't.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int can_scan_in_parallel(const query *compiled_query)
+{
+	return employee_count >= PARALLEL_SCAN_MIN_EMPLOYEES && compiled_query->name_from == NULL && compiled_query->name_to == NULL;
+}
+
+/*
+	Function: make_scan_partitions()
+	Purpose: Split the linked list into contiguous partitions of roughly equal size, without walking the whole list.
+					 The employees on the higher levels of the skip list are spread evenly through the list, so the partitions are split at employees on the
+					 highest level that has enough employees on it (taking every so many of them, if it has more than are needed).
+	Arguments: A pointer to where to store the address of the array of partitions (partitions), which is allocated by this function.
+						 The number of partitions wanted (wanted).
+	Return value: The number of partitions made, which may be fewer than wanted (but is always at least 1).
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static int make_scan_partitions(scan_partition **partitions, int wanted)
+{
+	employee *current_record;
+	int level, level_count = 0, step, count, i;
+
+	/* Find the highest level with at least wanted - 1 employees on it (these are where the partitions will be split) */
+	for(level = skip_list_levels - 1; level > 0; level--)
+	{
+		for(current_record = skip_list_next(NULL, level), level_count = 0; current_record != NULL; current_record = skip_list_next(current_record, level))
+			level_count++;
+		if(level_count >= wanted - 1)
+			break;
+	}
+	if(level == 0)
+		level_count = employee_count;
+
+	/* Only split at every step'th employee on that level, so that there are no more partitions than wanted */
+	step = level_count / wanted + 1;
+
+	*partitions = (scan_partition *)calloc(wanted, sizeof(scan_partition));
+	if(*partitions == NULL)
+		print_error("Problem allocating memory for searching the database.\nThe program will now exit.\n", DO_EXIT);
+
+	(*partitions)[0].first = head;
+	for(current_record = skip_list_next(NULL, level), i = 1, count = 1; current_record != NULL && count < wanted; current_record = skip_list_next(current_record, level), i++)
+		if(i % step == 0)
+		{
+			(*partitions)[count - 1].end = current_record;
+			(*partitions)[count].first = current_record;
+			count++;
+		}
+	(*partitions)[count - 1].end = NULL;
+
+	return count;
+}
+
+/*
+	Function: scan_one_partition()
+	Purpose: Test every employee in a partition against the scan's query, and collect what the scan needs from the matching employees.
+	Arguments: The scan (scan).
+						 The partition to scan (partition).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void scan_one_partition(const parallel_scan *scan, scan_partition *partition)
+{
+	employee *current_record;
+
+	for(current_record = partition->first; current_record != partition->end; current_record = current_record->next)
+	{
+		if(!conditions_are_true(scan->compiled_query->conditions, scan->compiled_query->condition_count, current_record))
+			continue;
+
+		if(scan->scan_type == SCAN_FOR_JOB_GROUPS)
+		{
+			add_to_job_group(find_job_group(partition->groups, &partition->group_count, current_record->job, ALL_SEXES), current_record->age);
+			add_to_job_group(find_job_group(partition->groups, &partition->group_count, current_record->job, current_record->sex), current_record->age);
+			continue;
+		}
+
+		/* Make more room for results if needed, doubling the space each time */
+		if(partition->result_count == partition->result_space)
+		{
+			partition->result_space = partition->result_space == 0 ? 256 : partition->result_space * 2;
+			partition->results = (employee **)realloc(partition->results, partition->result_space * sizeof(employee *));
+			if(partition->results == NULL)
+				print_error("Problem allocating memory for searching the database.\nThe program will now exit.\n", DO_EXIT);
+		}
+		partition->results[partition->result_count++] = current_record;
+	}
+
+	return;
+}
+
+/*
+	Function: scan_worker()
+	Purpose: The function run by each thread of a parallel scan, which keeps taking the next partition that hasn't been scanned and scanning it,
+					 until there are none left.
+	Arguments: A pointer to the parallel scan (scan).
+	Return value: NULL.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void *scan_worker(void *scan)
+{
+	parallel_scan *shared_scan = (parallel_scan *)scan;
+	int partition;
+
+	for(;;)
+	{
+		pthread_mutex_lock(&shared_scan->lock);
+		partition = shared_scan->next_partition++;
+		pthread_mutex_unlock(&shared_scan->lock);
+
+		if(partition >= shared_scan->partition_count)
+			return NULL;
+		scan_one_partition(shared_scan, &shared_scan->partitions[partition]);
+	}
+}
+
+/*
+	Function: run_parallel_scan()
+	Purpose: Scan every employee for a query on several threads (one for each processor, up to MAX_SCAN_THREADS, this thread being one of them).
+					 The results are left in the partitions of the scan, which are in alphabetical order, so reading them partition by partition gives the
+					 matching employees in alphabetical order. free_parallel_scan() must be called afterwards.
+					 If a thread can't be started, its share of the partitions is scanned by the other threads (or by this thread, if none could be started).
+	Arguments: The scan structure to fill in (scan).
+						 The compiled query (compiled_query).
+						 What to collect from the matching employees (scan_type), which uses the constants for scan types.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void run_parallel_scan(parallel_scan *scan, const query *compiled_query, int scan_type)
+{
+	pthread_t threads[MAX_SCAN_THREADS];
+	long thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+	int started, i;
+
+	if(thread_count < 1)
+		thread_count = 1;
+	if(thread_count > MAX_SCAN_THREADS)
+		thread_count = MAX_SCAN_THREADS;
+
+	scan->compiled_query = compiled_query;
+	scan->scan_type = scan_type;
+	scan->partition_count = make_scan_partitions(&scan->partitions, thread_count * PARTITIONS_PER_THREAD);
+	scan->next_partition = 0;
+	pthread_mutex_init(&scan->lock, NULL);
+
+	/* This thread is one of the threads scanning, so one fewer is started (none if there is only one processor) */
+	for(started = 0; started < thread_count - 1; started++)
+		if(pthread_create(&threads[started], NULL, scan_worker, scan) != 0)
+			break;
+
+	/* This thread scans alongside the others (or on its own, if no threads could be started), and then waits for the others to finish */
+	scan_worker(scan);
+	for(i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	pthread_mutex_destroy(&scan->lock);
+	return;
+}
+
+/*
+	Function: free_parallel_scan()
+	Purpose: Free the memory used by the partitions of a parallel scan, and the results and job groups in them.
+	Arguments: The scan (scan).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void free_parallel_scan(parallel_scan *scan)
+{
+	int i;
+
+	for(i = 0; i < scan->partition_count; i++)
+	{
+		free(scan->partitions[i].results);
+		free_job_groups(scan->partitions[i].groups);
+	}
+	free(scan->partitions);
+
+	return;
+}
+
+/*
+	Function: merge_job_group()
+	Purpose: Add the figures from a job group into the group for the same job and sex in a job group hash table.
+	Arguments: The hash table, an array of JOB_GROUP_BUCKETS pointers (table).
+						 A pointer to the number of groups in the table, which is increased if a new group is created (group_count).
+						 The group to add the figures from (group_to_merge).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for a new group.
+ */
+static void merge_job_group(job_group *table[], int *group_count, const job_group *group_to_merge)
+{
+	job_group *group = find_job_group(table, group_count, group_to_merge->job, group_to_merge->sex);
+
+	if(group->count == 0 || group_to_merge->min_age < group->min_age)
+		group->min_age = group_to_merge->min_age;
+	if(group->count == 0 || group_to_merge->max_age > group->max_age)
+		group->max_age = group_to_merge->max_age;
+	group->count += group_to_merge->count;
+	group->total_age += group_to_merge->total_age;
+
+	return;
+}
+
+/*
+	Function: compare_batch_employees()
+	Purpose: Compare two employees read from a file for qsort(), so that they are sorted alphabetically by name.
+					 Employees with the same name are put in the reverse of the order they were read in, which is the order place_employee()
+					 would have left them in (since it puts each employee before any others with the same name).
+	Arguments: Pointers to the two ranked employees to compare (first and second), whose positions are the order they were read in.
+	Return value: < 0 if the first employee belongs before the second, 0 if they are the same, > 0 if the first employee belongs after the second.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_batch_employees(const void *first, const void *second)
+{
+	const ranked_employee *first_employee = (const ranked_employee *)first;
+	const ranked_employee *second_employee = (const ranked_employee *)second;
+	int difference = strcmp(first_employee->record->name, second_employee->record->name);
+
+	if(difference == 0)
+		difference = second_employee->position - first_employee->position;
+	return difference;
+}
+
+/*
+	Function: read_employee_batch()
+	Purpose: Read every employee in a formatted database file (in the format read by read_employee_databases()), and sort them by name.
+					 The employees are handed a chunk at a time to another thread, which sorts each chunk while this thread reads the next
+					 (see import_sort_worker()), so waiting for the file (e.g. when it is a pipe from another program) and parsing it overlap with the sorting.
+					 Once the whole file has been read, the sorted chunks are merged (see merge_import_chunks()).
+					 If there is only one processor, or the sorting thread can't be started, the chunks are all sorted by this thread at the end.
+					 The employees are not added to the database.
+					 If a record in the file is invalid, every employee already read is freed, so that nothing is imported.
+	Arguments: The file pointer to read from (file_pointer).
+						 A pointer to where to store the number of employees read (count), which is set to -1 if the file is incorrectly formatted.
+	Return value: A pointer to an array of the employees read, sorted by name (which must be freed by the caller).
+								NULL if there are no employees, or the file is incorrectly formatted.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static ranked_employee *read_employee_batch(FILE *file_pointer, int *count)
+{
+	import_sorter sorter;
+	pthread_t sorting_thread;
+	ranked_employee *chunk = NULL, *batch;
+	employee *record;
+	int started, length = 0, more, invalid_field, c;
+
+	*count = 0;
+
+	/* An empty file has no employees in it */
+	c = fgetc(file_pointer);
+	if(c == EOF)
+		return NULL;
+	ungetc(c, file_pointer);
+
+	sorter.chunks = NULL;
+	sorter.chunk_count = sorter.chunk_space = sorter.sorted_count = 0;
+	sorter.finished = 0;
+	pthread_mutex_init(&sorter.lock, NULL);
+	pthread_cond_init(&sorter.changed, NULL);
+	/* There is only any point in a sorting thread if it can run at the same time as this one */
+	started = sysconf(_SC_NPROCESSORS_ONLN) > 1 && pthread_create(&sorting_thread, NULL, import_sort_worker, &sorter) == 0;
+
+	/* The file is only read by this thread, so it is locked for the whole of the reading rather than for every character read */
+	flockfile(file_pointer);
+
+	do{
+		if(length == 0)
+		{
+			chunk = (ranked_employee *)malloc(IMPORT_CHUNK_SIZE * sizeof(ranked_employee));
+			if(chunk == NULL)
+				print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
+		}
+		record = read_employee_record(file_pointer, &invalid_field);
+		if(record != NULL)
+		{
+			chunk[length].record = record;
+			chunk[length].position = (*count)++;
+			length++;
+		}
+
+		/* Hand the chunk over once it is full, or the end of the file (or an invalid record) has been reached */
+		more = record == NULL ? -1 : more_records_test(file_pointer);
+		if(length == IMPORT_CHUNK_SIZE || more != 1)
+		{
+			hand_over_import_chunk(&sorter, chunk, length, more != 1);
+			length = 0;
+		}
+	} while(more == 1);
+	funlockfile(file_pointer);
+
+	/* Wait for the last chunks to be sorted (or sort them all, if the sorting thread couldn't be started) */
+	if(started)
+		pthread_join(sorting_thread, NULL);
+	else
+		import_sort_worker(&sorter);
+
+	if(more == -1)
+	{
+		free_import_chunks(&sorter);
+		batch = NULL;
+		*count = -1;
+	}else
+		batch = merge_import_chunks(&sorter, *count);
+
+	pthread_mutex_destroy(&sorter.lock);
+	pthread_cond_destroy(&sorter.changed);
+	return batch;
+}
+
+/*
+	Function: merge_employee_batch()
+	Purpose: Add a batch of employees, sorted by compare_batch_employees(), to the database in a single pass along the linked list.
+					 The batch and the linked list are merged like the two halves of a merge sort, and every level of the skip list is relinked
+					 during the same pass, so adding m employees to n costs O(n + m) rather than a search for each employee.
+					 Each new employee goes before any employees already in the database with the same name, as with place_employee().
+					 As with place_employee(), a place metric is recorded for each new employee, covering the employees passed over to reach its position.
+	Arguments: The batch of employees (batch), and the number of employees in it (count).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+									 A TRACE_PLACE_EMPLOYEE event is recorded for each new employee, if tracing is on.
+ */
+static void merge_employee_batch(ranked_employee batch[], int count)
+{
+	/* The last employee linked on each level (NULL until an employee has been linked on that level) */
+	employee *last[SKIP_LIST_MAX_LEVELS];
+	employee *current_record = head, *next_employee;
+	int i = 0, level;
+	metrics_timer timer;
+
+	if(count == 0)
+		return;
+
+	for(level = 0; level < SKIP_LIST_MAX_LEVELS; level++)
+		last[level] = NULL;
+
+	/* The employees are given their ids in the order they were read in, so that those with the same name end up in descending order of id */
+	for(i = 0; i < count; i++)
+		batch[i].record->id = next_employee_id + batch[i].position;
+	next_employee_id += count;
+
+	metrics_start(&timer);
+	for(i = 0; i < count || current_record != NULL; )
+	{
+		/* Take the next employee from the batch if its name is before (or the same as) the next one in the list */
+		if(i < count && (current_record == NULL || strcmp(batch[i].record->name, current_record->name) <= 0))
+		{
+			next_employee = batch[i++].record;
+			skip_list_choose_levels(next_employee);
+			if(next_employee->skip_levels > skip_list_levels)
+				skip_list_levels = next_employee->skip_levels;
+			name_index_add(next_employee);
+			add_to_views(next_employee);
+			invalidate_query_cache(next_employee);
+
+			/* The employee goes between the last employee linked and current_record */
+			TRACE(TRACE_PLACE_EMPLOYEE, next_employee, last[0], current_record, 0);
+			metrics_stop(METRIC_PLACE, &timer);
+			metrics_start(&timer);
+		}else
+		{
+			next_employee = current_record;
+			current_record = current_record->next;
+			employees_visited++;
+		}
+
+		/* Link the employee after the last employee on each of its levels */
+		next_employee->prev = last[0];
+		for(level = 0; level < next_employee->skip_levels; level++)
+		{
+			skip_list_set_next(last[level], level, next_employee);
+			last[level] = next_employee;
+		}
+	}
+
+	/* End every level after the last employee on it */
+	for(level = 0; level < skip_list_levels; level++)
+		skip_list_set_next(last[level], level, NULL);
+
+	return;
+}
+
+/*
+	Function: menu_import_employees()
+	Purpose: A function, designed to be called from the menu system, that adds every employee in a formatted database file to the database.
+					 The employees are sorted by name and then merged into the database in a single pass (see merge_employee_batch()).
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The name of the file to import.
+	Outputs to user: Prompts, error messages and the number of employees imported (written to stderr).
+									 If the file is incorrectly formatted, nothing is imported and the database is left as it was.
+									 The program may exit, if there is a problem allocating memory.
+ */
+static void menu_import_employees(void)
+{
+	char file_name[MAX_FILE_NAME_LENGTH + 1];
+	FILE *file_pointer;
+	ranked_employee *batch;
+	int count;
+
+	fputs("Please enter the name of the file to import employees from: ", stderr);
+	if(read_line(stdin, file_name, MAX_FILE_NAME_LENGTH) != 0)
+		return;
+
+	file_pointer = fopen(file_name, "r");
+	if(file_pointer == NULL)
+	{
+		fputs("Error opening file, no employees have been imported.\n", stderr);
+		return;
+	}
+	setvbuf(file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	batch = read_employee_batch(file_pointer, &count);
+	fclose(file_pointer);
+	if(count == -1)
+	{
+		fputs("The file is incorrectly formatted, no employees have been imported.\n", stderr);
+		return;
+	}
+
+	merge_employee_batch(batch, count);
+	free(batch);
+
+	fprintf(stderr, "%d employee(s) imported.\n", count);
+	return;
+}
+
+/*
+	Function: delete_employees_where()
+	Purpose: Delete every employee that a test function picks, in a single pass along the linked list.
+					 The employees that are kept are relinked on every level of the skip list during the same pass, so deleting many employees
+					 costs O(n) in total rather than a search for each one.
+	Arguments: The test function (should_delete), which is called for each employee in alphabetical order and returns TRUE if it should be deleted.
+						 A pointer that is passed on to the test function (context).
+	Return value: The number of employees deleted.
+	Inputs from user: None.
+	Outputs to user: None (a TRACE_DELETE_EMPLOYEE event is recorded for each employee deleted if tracing is on).
+ */
+static int delete_employees_where(int (*should_delete)(const employee *employee_to_test, void *context), void *context)
+{
+	/* The last employee kept on each level (NULL until an employee has been kept on that level) */
+	employee *last[SKIP_LIST_MAX_LEVELS];
+	employee *current_record, *next_employee;
+	int level, count = 0;
+	metrics_timer timer;
+
+	metrics_start(&timer);
+	for(level = 0; level < SKIP_LIST_MAX_LEVELS; level++)
+		last[level] = NULL;
+
+	for(current_record = head; current_record != NULL; current_record = next_employee)
+	{
+		next_employee = current_record->next;
+		employees_visited++;
+
+		if(should_delete(current_record, context))
+		{
+			/* The employee is between the last employee kept and the next one to be tested */
+			TRACE(TRACE_DELETE_EMPLOYEE, current_record, last[0], next_employee, 0);
+			name_index_remove(current_record);
+			remove_from_views(current_record);
+			invalidate_query_cache(current_record);
+			free_employee(current_record);
+			count++;
+			continue;
+		}
+
+		/* Link the employee after the last employee kept on each of its levels */
+		current_record->prev = last[0];
+		for(level = 0; level < current_record->skip_levels; level++)
+		{
+			skip_list_set_next(last[level], level, current_record);
+			last[level] = current_record;
+		}
+	}
+
+	/* End every level after the last employee kept on it */
+	for(level = 0; level < skip_list_levels; level++)
+		skip_list_set_next(last[level], level, NULL);
+
+	metrics_stop(METRIC_DELETE, &timer);
+	return count;
+}
+
+/*
+	Function: compare_names()
+	Purpose: Compare two names for qsort(), so that they are sorted alphabetically.
+	Arguments: Pointers to the two names to compare (first and second).
+	Return value: < 0 if the first name belongs before the second, 0 if they are the same, > 0 if the first name belongs after the second.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_names(const void *first, const void *second)
+{
+	return strcmp((const char *)first, (const char *)second);
+}
+
+/* Name list structure, used by name_is_in_list() */
+struct name_list_struct
+{
+	char (*names)[MAX_NAME_LENGTH+1];     /* the names, sorted alphabetically */
+	char *matched;                        /* 1 for each name that an employee has been found with (only the first of any repeated name is set) */
+	int count;                            /* the number of names */
+	int next;                             /* the first name that hasn't been passed yet */
+};
+
+/*
+	Function: name_is_in_list()
+	Purpose: A test function for delete_employees_where(), which picks employees whose names are in a sorted list of names.
+					 As the employees are tested in alphabetical order, the list is walked alongside the linked list rather than searched.
+	Arguments: The employee to test (employee_to_test).
+						 A pointer to the name list structure (context).
+	Return value: 1 if the employee's name is in the list.
+								0 if it isn't.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int name_is_in_list(const employee *employee_to_test, void *context)
+{
+	struct name_list_struct *list = (struct name_list_struct *)context;
+
+	/* Move past the names that belong before this employee's name */
+	while(list->next < list->count && strcmp(list->names[list->next], employee_to_test->name) < 0)
+		list->next++;
+
+	if(list->next < list->count && strcmp(list->names[list->next], employee_to_test->name) == 0)
+	{
+		list->matched[list->next] = 1;
+		return 1;
+	}
+	return 0;
+}
+
+/*
+	Function: employee_matches_query()
+	Purpose: A test function for delete_employees_where(), which picks employees matching a compiled query.
+	Arguments: The employee to test (employee_to_test).
+						 A pointer to the compiled query (context).
+	Return value: 1 if the employee matches the query.
+								0 if it doesn't.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int employee_matches_query(const employee *employee_to_test, void *context)
+{
+	const query *compiled_query = (const query *)context;
+	return conditions_are_true(compiled_query->conditions, compiled_query->condition_count, employee_to_test);
+}
+
+/*
+	Function: menu_delete_listed_employees()
+	Purpose: A function, designed to be called from the menu system, that deletes all the employees whose names are listed in a file (one name per line).
+					 The names are sorted, and the employees deleted in a single pass along the linked list (see delete_employees_where()).
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The name of the file listing the names.
+	Outputs to user: Prompts, error messages, each name that no employee was found with, and the number of employees deleted (written to stderr).
+									 The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void menu_delete_listed_employees(void)
+{
+	char file_name[MAX_FILE_NAME_LENGTH + 1];
+	FILE *file_pointer;
+	struct name_list_struct list;
+	int space = 0, end_of_file, i;
+
+	fputs("Please enter the name of the file listing the employees to delete: ", stderr);
+	if(read_line(stdin, file_name, MAX_FILE_NAME_LENGTH) != 0)
+		return;
+
+	file_pointer = fopen(file_name, "r");
+	if(file_pointer == NULL)
+	{
+		fputs("Error opening file, no employees have been deleted.\n", stderr);
+		return;
+	}
+	setvbuf(file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	/* Read the names, making more room when needed by doubling the space each time */
+	list.names = NULL;
+	list.count = 0;
+	list.next = 0;
+	for(;;)
+	{
+		if(list.count == space)
+		{
+			space = space == 0 ? 1024 : space * 2;
+			list.names = (char (*)[MAX_NAME_LENGTH+1])realloc(list.names, space * sizeof(*list.names));
+			if(list.names == NULL)
+				print_error("Problem allocating memory for the list of employees to delete.\nThe program will now exit.\n", DO_EXIT);
+		}
+		/* The last name is kept even if there is no end of line after it */
+		end_of_file = read_line(file_pointer, list.names[list.count], MAX_NAME_LENGTH) != 0;
+		if(list.names[list.count][0] != '\0')
+			list.count++;
+		if(end_of_file)
+			break;
+	}
+	fclose(file_pointer);
+
+	list.matched = (char *)calloc(list.count + 1, 1);
+	if(list.matched == NULL)
+		print_error("Problem allocating memory for the list of employees to delete.\nThe program will now exit.\n", DO_EXIT);
+
+	qsort(list.names, list.count, sizeof(*list.names), compare_names);
+	fprintf(stderr, "%d employee(s) deleted.\n", delete_employees_where(name_is_in_list, &list));
+
+	/* Report the names that no employee was found with, once each */
+	for(i = 0; i < list.count; i++)
+		if(!list.matched[i] && (i == 0 || strcmp(list.names[i], list.names[i - 1]) != 0))
+			fprintf(stderr, "No employee named %s was found.\n", list.names[i]);
+
+	free(list.matched);
+	free(list.names);
+	return;
+}
+
+/*
+	Function: menu_delete_matching_employees()
+	Purpose: A function, designed to be called from the menu system, that deletes all the employees matching a query
+					 (in the same form as for menu_search_database()), in a single pass along the linked list (see delete_employees_where()).
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The query.
+	Outputs to user: Prompts, error messages and the number of employees deleted (written to stderr).
+ */
+static void menu_delete_matching_employees(void)
+{
+	char query_text[MAX_CHARS_TO_READ + 1];
+	query compiled_query;
+
+	fputs("Please enter the query for the employees to delete (e.g. age >= 65 AND job = 'Engineer'): ", stderr);
+	if(read_line(stdin, query_text, MAX_CHARS_TO_READ) != 0 || compile_query(query_text, &compiled_query) != 0)
+		return;
+
+	/* An empty query would delete every employee, which is much more likely to be a mistake than intended */
+	if(compiled_query.condition_count == 0)
+	{
+		fputs("The query must have at least one condition, no employees have been deleted.\n", stderr);
+		return;
+	}
+
+	fprintf(stderr, "%d employee(s) deleted.\n", delete_employees_where(employee_matches_query, &compiled_query));
+	return;
+}
+
+/*
+	Function: update_employee()
+	Purpose: Change the details of an employee that is in the database, without deleting it and adding it again.
+					 A change to the sex, age or job leaves the employee where it is in the linked list, and only updates the figures kept about the database.
+					 A change to the name also leaves the employee where it is if the new name still belongs between its neighbours,
+					 otherwise it is unlinked and linked in again where the new name belongs (getting a new id, as it goes before any others with that name).
+					 Any remembered query results that the employee belonged in before or after the change are thrown away.
+	Arguments: The employee to change (employee_to_update).
+						 The new details for the employee (new_details).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
+ */
+static void update_employee(employee *employee_to_update, const employee *new_details)
+{
+	employee *update[SKIP_LIST_MAX_LEVELS];
+	metrics_timer timer;
+
+	metrics_start(&timer);
+	invalidate_query_cache(employee_to_update);
+	remove_from_views(employee_to_update);
+
+	if(strcmp(employee_to_update->name, new_details->name) != 0)
+	{
+		name_index_remove(employee_to_update);
+
+		if((employee_to_update->prev == NULL || strcmp(employee_to_update->prev->name, new_details->name) < 0) &&
+			 (employee_to_update->next == NULL || strcmp(new_details->name, employee_to_update->next->name) < 0))
+		{
+			/* The new name belongs where the employee already is, so only the name index needs changing */
+			set_employee_strings(employee_to_update, new_details->name, new_details->job);
+			name_index_add(employee_to_update);
+		}else{
+			/* Unlink the employee from the linked list and the skip list, in the same way as delete_employee_from_list() */
+			if(employee_to_update->prev != NULL)
+				(employee_to_update->prev)->next = employee_to_update->next;
+			if(employee_to_update->next != NULL)
+				(employee_to_update->next)->prev = employee_to_update->prev;
+			if(employee_to_update == head)
+				head = employee_to_update->next;
+			skip_list_remove(employee_to_update);
+			free(employee_to_update->skip_next);
+
+			set_employee_strings(employee_to_update, new_details->name, new_details->job);
+			employee_to_update->sex = new_details->sex;
+			employee_to_update->age = new_details->age;
+
+			/* link_employee() adds the employee back to the name index, the figures kept about the database and the query cache checks */
+			skip_list_find(employee_to_update->name, update);
+			link_employee(employee_to_update, update);
+			metrics_stop(METRIC_UPDATE, &timer);
+			return;
+		}
+	}
+
+	employee_to_update->sex = new_details->sex;
+	employee_to_update->age = new_details->age;
+	if(strcmp(employee_to_update->job, new_details->job) != 0)
+		set_employee_strings(employee_to_update, new_details->name, new_details->job);
+
+	add_to_views(employee_to_update);
+	invalidate_query_cache(employee_to_update);
+
+	metrics_stop(METRIC_UPDATE, &timer);
+	return;
+}
+
+/*
+	Function: read_new_value()
+	Purpose: Prompt the user for a new value for one of an employee's details, showing the current value, and read it.
+	Arguments: The name of the structure member (field_name).
+						 The current value, as a string (current_value).
+						 The string to store the new value in (string).
+						 The maximum number of characters to read (max_length).
+	Return value: 1 if a new value was entered.
+								0 if the user pressed enter without typing anything, meaning the current value should be kept.
+								-1 if the end of file character EOF is reached.
+	Inputs from user: The new value.
+	Outputs to user: The prompt (written to stderr).
+ */
+static int read_new_value(const char *field_name, const char *current_value, char *string, int max_length)
+{
+	fprintf(stderr, "Please enter the new %s (or press enter to keep %s): ", field_name, current_value);
+	if(read_line(stdin, string, max_length) != 0)
+		return -1;
+	return string[0] != '\0';
+}
+
+/*
+	Function: menu_update_employee()
+	Purpose: A function, designed to be called from the menu system, that changes the details of an employee (see update_employee()).
+					 If more than one employee has the name given, the first one printed by the print option is changed.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: The name of the employee to change, and the new value for each of its details (or nothing to keep the current value).
+	Outputs to user: Prompts and error messages (written to stderr).
+ */
+static void menu_update_employee(void)
+{
+	char name[MAX_NAME_LENGTH + 1];
+	char buffer[MAX_CHARS_TO_READ + 1];
+	char new_name[MAX_NAME_LENGTH + 1], new_job[MAX_JOB_LENGTH + 1];
+	employee *employee_to_update;
+	employee new_details;
+	int result;
+
+	fputs("Please enter the name of the employee to be updated: ", stderr);
+	if(read_line(stdin, name, MAX_NAME_LENGTH) != 0)
+		return;
+
+	employee_to_update = search_for_employee(name);
+	if(employee_to_update == NULL)
+	{
+		fputs("Employee not found.\n", stderr);
+		return;
+	}
+
+	/* Each detail starts as the current value, and is only replaced if valid input is entered */
+	new_details.name = strcpy(new_name, employee_to_update->name);
+	new_details.sex = employee_to_update->sex;
+	new_details.age = employee_to_update->age;
+	new_details.job = strcpy(new_job, employee_to_update->job);
+
+	if(read_new_value(structure_member_name[NAME_IDENTIFIER], employee_to_update->name, new_details.name, MAX_NAME_LENGTH) == -1)
+		return;
+	if(new_details.name[0] == '\0')
+		strcpy(new_details.name, employee_to_update->name);
+
+	sprintf(buffer, "%c", employee_to_update->sex);
+	while((result = read_new_value(structure_member_name[SEX_IDENTIFIER], buffer, buffer, 2)) == 1 &&
+				((buffer[0] != 'M' && buffer[0] != 'F') || buffer[1] != '\0'))
+	{
+		fprintf(stderr, "Invalid %s, please enter again.\n", structure_member_name[SEX_IDENTIFIER]);
+		sprintf(buffer, "%c", employee_to_update->sex);
+	}
+	if(result == -1)
+		return;
+	if(result == 1)
+		new_details.sex = buffer[0];
+
+	sprintf(buffer, "%d", employee_to_update->age);
+	while((result = read_new_value(structure_member_name[AGE_IDENTIFIER], buffer, buffer, MAX_CHARS_TO_READ)) == 1 &&
+				(sscanf(buffer, "%d%1[^\n]", &new_details.age, buffer) != 1 || new_details.age < 0))
+	{
+		fprintf(stderr, "Invalid %s, please enter again.\n", structure_member_name[AGE_IDENTIFIER]);
+		sprintf(buffer, "%d", employee_to_update->age);
+	}
+	if(result == -1)
+		return;
+	if(result == 0)
+		new_details.age = employee_to_update->age;
+
+	if(read_new_value(structure_member_name[JOB_IDENTIFIER], employee_to_update->job, new_details.job, MAX_JOB_LENGTH) == -1)
+		return;
+	if(new_details.job[0] == '\0')
+		strcpy(new_details.job, employee_to_update->job);
+
+	update_employee(employee_to_update, &new_details);
+	return;
+}
+
+/*
+	Function: metrics_clock()
+	Purpose: Read the monotonic clock, for timing operations.
+	Arguments: None.
+	Return value: The current time, in nanoseconds.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long long metrics_clock(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/*
+	Function: metrics_bucket()
+	Purpose: Work out which metrics histogram bucket a value belongs in (see METRIC_BUCKETS).
+	Arguments: The value (value).
+	Return value: The bucket, from 0 to METRIC_BUCKETS - 1.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int metrics_bucket(unsigned long long value)
+{
+	int shift;
+
+	/* Drop the low bits until the value is one of the 2 * METRIC_SUB_BUCKETS exact values; each bit dropped moves it up by a power of two */
+	for(shift = 0; value >= 2 * METRIC_SUB_BUCKETS; shift++)
+		value >>= 1;
+
+	return shift * METRIC_SUB_BUCKETS + (int)value;
+}
+
+/*
+	Function: metrics_bucket_limit()
+	Purpose: Work out the largest value that belongs in a metrics histogram bucket.
+	Arguments: The bucket (bucket).
+	Return value: The largest value in the bucket.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long long metrics_bucket_limit(int bucket)
+{
+	int shift = bucket / METRIC_SUB_BUCKETS - 1;
+
+	if(bucket < 2 * METRIC_SUB_BUCKETS)
+		return bucket;
+	if(bucket == METRIC_BUCKETS - 1)
+		return ULLONG_MAX;
+
+	return ((unsigned long long)(bucket % METRIC_SUB_BUCKETS + METRIC_SUB_BUCKETS + 1) << shift) - 1;
+}
+
+/*
+	Function: metrics_start()
+	Purpose: Start timing an operation.
+	Arguments: The timer to start (timer), which is passed to metrics_stop() when the operation has finished.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void metrics_start(metrics_timer *timer)
+{
+	timer->start_visited = employees_visited;
+	timer->start_time = metrics_clock();
+	return;
+}
+
+/*
+	Function: metrics_stop()
+	Purpose: Stop timing an operation, and add the time it took and the number of employees it visited to the runtime metrics.
+	Arguments: The operation (operation), one of the metric codes defined above.
+						 The timer that was started by metrics_start() (timer).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void metrics_stop(int operation, const metrics_timer *timer)
+{
+	unsigned long long time_taken = metrics_clock() - timer->start_time;
+	unsigned long walk = employees_visited - timer->start_visited;
+	operation_metrics *operation_metrics_ptr = &metrics[operation];
+
+	operation_metrics_ptr->count++;
+	operation_metrics_ptr->total_time += time_taken;
+	if(time_taken > operation_metrics_ptr->max_time)
+		operation_metrics_ptr->max_time = time_taken;
+	operation_metrics_ptr->time_histogram[metrics_bucket(time_taken)]++;
+
+	operation_metrics_ptr->total_walk += walk;
+	if(walk > operation_metrics_ptr->max_walk)
+		operation_metrics_ptr->max_walk = walk;
+	operation_metrics_ptr->walk_histogram[metrics_bucket(walk)]++;
+
+	return;
+}
+
+/*
+	Function: metrics_percentile()
+	Purpose: Find (to within the precision of the buckets) a percentile of the values counted in a metrics histogram.
+	Arguments: The histogram (histogram).
+						 The number of values counted in it (count), which must be more than 0.
+						 The largest value counted in it (largest).
+						 The percentile to find (percent).
+	Return value: The largest value in the bucket that the percentile falls in, or largest if that is smaller.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long long metrics_percentile(const unsigned long histogram[], unsigned long count, unsigned long long largest, int percent)
+{
+	unsigned long wanted = (count * percent + 99) / 100, so_far = 0;
+	int bucket;
+
+	for(bucket = 0; bucket < METRIC_BUCKETS - 1; bucket++)
+	{
+		so_far += histogram[bucket];
+		if(so_far >= wanted)
+			break;
+	}
+
+	return metrics_bucket_limit(bucket) < largest ? metrics_bucket_limit(bucket) : largest;
+}
+
+/*
+	Function: menu_print_metrics()
+	Purpose: A function, designed to be called from the menu system, that prints a table of the runtime metrics for each operation:
+					 the number of calls, the total and mean time, the 50th and 99th percentile and largest times,
+					 and the mean and largest numbers of employees visited.
+					 The percentiles are the upper limit of the histogram bucket they fall in, so may be up to 12.5% above the true value.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The table, printed to stdout.
+ */
+static void menu_print_metrics(void)
+{
+	const operation_metrics *operation_metrics_ptr;
+	int operation;
+
+	printf("%-10s %10s %12s %10s %10s %10s %10s %10s %10s\n",
+				 "operation", "calls", "total ms", "mean us", "p50 us", "p99 us", "max us", "mean walk", "max walk");
+	for(operation = 0; operation < METRIC_OPERATIONS; operation++)
+	{
+		operation_metrics_ptr = &metrics[operation];
+		if(operation_metrics_ptr->count == 0)
+		{
+			printf("%-10s %10d\n", metric_name[operation], 0);
+			continue;
+		}
+
+		printf("%-10s %10lu %12.3f %10.3f %10.3f %10.3f %10.3f %10.1f %10lu\n", metric_name[operation], operation_metrics_ptr->count,
+					 operation_metrics_ptr->total_time / 1e6, operation_metrics_ptr->total_time / 1e3 / operation_metrics_ptr->count,
+					 metrics_percentile(operation_metrics_ptr->time_histogram, operation_metrics_ptr->count, operation_metrics_ptr->max_time, 50) / 1e3,
+					 metrics_percentile(operation_metrics_ptr->time_histogram, operation_metrics_ptr->count, operation_metrics_ptr->max_time, 99) / 1e3,
+					 operation_metrics_ptr->max_time / 1e3,
+					 (double)operation_metrics_ptr->total_walk / operation_metrics_ptr->count, operation_metrics_ptr->max_walk);
+	}
+
+	return;
+}
+
+/*
+	Function: dump_metrics()
+	Purpose: Write the runtime metrics for each operation in a form that is easy for another program to read.
+					 Each operation is written on one line, as the word "metrics" followed by name=value pairs separated by spaces.
+					 The histograms are written as comma separated counts for buckets 0 up to the last bucket that isn't empty,
+					 laid out as described for METRIC_SUB_BUCKETS, which is written as sub_buckets so the counts can be decoded.
+	Arguments: The stream to write to (fp).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The metrics, written to fp.
+ */
+static void dump_metrics(FILE *fp)
+{
+	const operation_metrics *operation_metrics_ptr;
+	const unsigned long *histogram;
+	int operation, which, bucket, last;
+
+	for(operation = 0; operation < METRIC_OPERATIONS; operation++)
+	{
+		operation_metrics_ptr = &metrics[operation];
+		fprintf(fp, "metrics operation=%s calls=%lu total_ns=%llu max_ns=%llu total_walk=%llu max_walk=%lu sub_buckets=%d",
+						metric_name[operation], operation_metrics_ptr->count, operation_metrics_ptr->total_time,
+						operation_metrics_ptr->max_time, operation_metrics_ptr->total_walk, operation_metrics_ptr->max_walk, METRIC_SUB_BUCKETS);
+
+		/* The time histogram, then the walk histogram */
+		for(which = 0; which < 2; which++)
+		{
+			histogram = which == 0 ? operation_metrics_ptr->time_histogram : operation_metrics_ptr->walk_histogram;
+			for(last = METRIC_BUCKETS - 1; last > 0 && histogram[last] == 0; last--)
+				;
+
+			fputs(which == 0 ? " time_histogram=" : " walk_histogram=", fp);
+			for(bucket = 0; bucket <= last; bucket++)
+				fprintf(fp, bucket == 0 ? "%lu" : ",%lu", histogram[bucket]);
+		}
+		fputc('\n', fp);
+	}
+
+	return;
+}
+
+/*
+	Function: trace_event_add()
+	Purpose: Record an event in this thread's trace ring buffer, replacing the oldest event if the buffer is full.
+					 This is called through the TRACE() macro, which only calls it if tracing is on.
+	Arguments: The type of event (type), one of the constants for types of trace event.
+						 The employee the event is about, and the employees before and after it (employee_ptr, before and after), any of which may be NULL.
+						 A number whose meaning depends on the type of event (value).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void trace_event_add(int type, const employee *employee_ptr, const employee *before, const employee *after, int value)
+{
+	trace_event *event;
+
+	if(trace_ring == NULL)
+		trace_ring = acquire_trace_buffer();
+	event = &trace_ring->events[trace_ring->recorded++ % TRACE_RING_SIZE];
+
+	event->time = metrics_clock() - trace_start_time;
+	event->employee = (unsigned long long)(size_t)employee_ptr;
+	event->before = (unsigned long long)(size_t)before;
+	event->after = (unsigned long long)(size_t)after;
+	event->type = type;
+	event->value = value;
+	return;
+}
+
+/*
+	Function: acquire_trace_buffer()
+	Purpose: Find a trace buffer for the calling thread, reusing one whose thread has finished if there is one, or allocating a new one.
+					 The buffer is handed back by release_trace_buffer() when the thread finishes.
+	Arguments: None.
+	Return value: The trace buffer.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for the ring buffer.
+ */
+static trace_buffer *acquire_trace_buffer(void)
+{
+	trace_buffer *buffer;
+
+	pthread_mutex_lock(&trace_lock);
+	for(buffer = trace_buffers; buffer != NULL && buffer->in_use; buffer = buffer->next)
+		;
+
+	/* A reused buffer carries on from its last event, which is older than any the new thread will record */
+	if(buffer == NULL)
+	{
+		buffer = (trace_buffer *)malloc(sizeof(trace_buffer));
+		if(buffer == NULL || (buffer->events = (trace_event *)malloc(TRACE_RING_SIZE * sizeof(trace_event))) == NULL)
+			print_error("Problem allocating memory for tracing.\nThe program will now exit.\n", DO_EXIT);
+		buffer->recorded = 0;
+		buffer->next = trace_buffers;
+		trace_buffers = buffer;
+		trace_buffer_count++;
+	}
+	buffer->in_use = 1;
+	pthread_mutex_unlock(&trace_lock);
+
+	pthread_setspecific(trace_thread_key, buffer);
+	return buffer;
+}
+
+/*
+	Function: release_trace_buffer()
+	Purpose: Hand back the trace buffer of a thread that has finished, so that another thread can reuse it.
+					 This is called as the destructor of trace_thread_key, and the events in the buffer are kept for the trace file.
+	Arguments: The trace buffer (buffer).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void release_trace_buffer(void *buffer)
+{
+	pthread_mutex_lock(&trace_lock);
+	((trace_buffer *)buffer)->in_use = 0;
+	pthread_mutex_unlock(&trace_lock);
+	return;
+}
+
+/*
+	Function: start_tracing()
+	Purpose: Turn tracing on, allocating the main thread's ring buffer if this is the first time.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory for the ring buffer.
+ */
+static void start_tracing(void)
+{
+	if(trace_ring == NULL)
+	{
+		pthread_key_create(&trace_thread_key, release_trace_buffer);
+		trace_start_time = metrics_clock();
+		trace_ring = acquire_trace_buffer();
+	}
+
+	tracing = 1;
+	return;
+}
+
+/*
+	Function: write_trace_file()
+	Purpose: Write the events in every thread's ring buffer to a trace file, oldest first, after a trace_file_header.
+					 The events in each buffer are already in time order, so the buffers are merged by taking the earliest next event of them all each time.
+					 The file is binary, and is read with TYLERJ-decode-trace.c.
+	Arguments: The name of the file to write (file_name).
+	Return value: The number of events written, if the file was written successfully.
+								-1 is returned if there was a problem writing the file.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static long write_trace_file(const char *file_name)
+{
+	FILE *file_pointer;
+	trace_file_header header;
+	trace_buffer *buffer, **buffers;
+	unsigned long long *next_event;
+	int buffer_count = 0, earliest, i;
+	long result = 0;
+
+	memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+	header.event_size = sizeof(trace_event);
+	header.recorded = 0;
+	header.saved = 0;
+
+	pthread_mutex_lock(&trace_lock);
+	buffers = (trace_buffer **)malloc(trace_buffer_count * sizeof(trace_buffer *));
+	next_event = (unsigned long long *)malloc(trace_buffer_count * sizeof(unsigned long long));
+	file_pointer = buffers != NULL && next_event != NULL ? fopen(file_name, "wb") : NULL;
+	if(file_pointer == NULL)
+	{
+		pthread_mutex_unlock(&trace_lock);
+		free(buffers);
+		free(next_event);
+		return -1;
+	}
+
+	/* The oldest event in each buffer is the first one recorded until the buffer fills up, then it is the one TRACE_RING_SIZE before the next */
+	for(buffer = trace_buffers; buffer != NULL; buffer = buffer->next)
+	{
+		buffers[buffer_count] = buffer;
+		next_event[buffer_count] = buffer->recorded > TRACE_RING_SIZE ? buffer->recorded - TRACE_RING_SIZE : 0;
+		header.recorded += buffer->recorded;
+		header.saved += buffer->recorded - next_event[buffer_count];
+		buffer_count++;
+	}
+
+	if(fwrite(&header, sizeof(header), 1, file_pointer) != 1)
+		result = -1;
+	while(result == 0)
+	{
+		earliest = -1;
+		for(i = 0; i < buffer_count; i++)
+		{
+			if(next_event[i] == buffers[i]->recorded)
+				continue;
+			if(earliest == -1 || buffers[i]->events[next_event[i] % TRACE_RING_SIZE].time < buffers[earliest]->events[next_event[earliest] % TRACE_RING_SIZE].time)
+				earliest = i;
+		}
+		if(earliest == -1)
+			break;
+
+		if(fwrite(&buffers[earliest]->events[next_event[earliest]++ % TRACE_RING_SIZE], sizeof(trace_event), 1, file_pointer) != 1)
+			result = -1;
+	}
+	pthread_mutex_unlock(&trace_lock);
+
+	if(fclose(file_pointer) != 0)
+		result = -1;
+	free(buffers);
+	free(next_event);
+
+	return result == 0 ? (long)header.saved : -1;
+}
+
+/*
+	Function: menu_switch_tracing()
+	Purpose: A function, designed to be called from the menu system, that turns tracing on if it is off, or off if it is on.
+					 When tracing is turned off the trace so far is written to the trace file, and turning it on again carries on the same trace.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: A message saying whether tracing is now on or off, and where the trace is written (printed to stderr).
+									 The fact that the program may terminate if there is a problem allocating memory for the ring buffer.
+ */
+static void menu_switch_tracing(void)
+{
+	long saved;
+
+	if(!tracing)
+	{
+		start_tracing();
+		fprintf(stderr, "Tracing is on, the trace will be written to %s.\n", trace_file_name);
+		return;
+	}
+
+	tracing = 0;
+	saved = write_trace_file(trace_file_name);
+	if(saved < 0)
+		fprintf(stderr, "Tracing is off, but there was an error writing the trace to %s.\n", trace_file_name);
+	else
+		fprintf(stderr, "Tracing is off, %ld events have been written to %s.\n", saved, trace_file_name);
+	return;
+}
+
+/*
+	Function: malloc_footprint()
+	Purpose: Estimate how much memory malloc() really uses for an allocation, including its bookkeeping and rounding.
+	Arguments: The size asked for (size).
+	Return value: The estimated number of bytes used.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static unsigned long malloc_footprint(unsigned long size)
+{
+	unsigned long footprint = (size + MALLOC_OVERHEAD + MALLOC_ALIGNMENT - 1) / MALLOC_ALIGNMENT * MALLOC_ALIGNMENT;
+	return footprint < MALLOC_MINIMUM ? MALLOC_MINIMUM : footprint;
+}
+
+/*
+	Function: resident_set_size()
+	Purpose: Find how much of the program's memory is actually in RAM, from /proc/self/statm.
+	Arguments: None.
+	Return value: The resident set size in bytes, or -1 if it can't be found (e.g. the system has no /proc).
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static long resident_set_size(void)
+{
+	FILE *file_pointer = fopen("/proc/self/statm", "r");
+	long total_pages, resident_pages;
+	int result;
+
+	if(file_pointer == NULL)
+		return -1;
+	result = fscanf(file_pointer, "%ld %ld", &total_pages, &resident_pages);
+	fclose(file_pointer);
+
+	return result == 2 ? resident_pages * sysconf(_SC_PAGESIZE) : -1;
+}
+
+/*
+	Function: print_memory_line()
+	Purpose: Print a line of the memory report, with the number of bytes and (if there are any employees) the bytes per employee.
+	Arguments: What the bytes are used for (label).
+						 The number of bytes (bytes).
+						 The number of employees to divide by for the bytes per employee (employees).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: The line, printed to stdout.
+ */
+static void print_memory_line(const char *label, double bytes, long employees)
+{
+	printf("%-34s %14.0f", label, bytes);
+	if(employees > 0)
+		printf(" %12.1f", bytes / employees);
+	putchar('\n');
+	return;
+}
+
+/*
+	Function: menu_print_memory_report()
+	Purpose: A function, designed to be called from the menu system, that prints how the memory used by the database is made up:
+					 the bytes used by the name and job strings, the employee structures, the skip list pointers, allocator overhead (including free employee structures), and the size of the indexes and views.
+					 Allocator overhead is estimated (see malloc_footprint()), and the total is compared with the resident set size.
+					 If the user enters a number of employees, the memory needed for that many employees is projected from the figures per employee.
+	Arguments: None.
+	Return value: None.
+	Inputs from user: A number of employees to project memory use for (or nothing).
+	Outputs to user: A prompt (written to stderr), and the report (printed to stdout).
+ */
+static void menu_print_memory_report(void)
+{
+	char buffer[MAX_CHARS_TO_READ + 1];
+	long projected_count = -1, rss;
+	const employee *current_record;
+	const query_cache_entry *entry;
+	unsigned long string_bytes = 0, string_allocations = 0, skip_pointers = 0, skip_allocations = 0, cache_bytes = 0, allocated_structures;
+	unsigned long record_strings;
+	double per_employee, fixed, overhead;
+
+	fputs("Please enter a number of employees to project memory use for (or press enter for none): ", stderr);
+	if(read_line(stdin, buffer, MAX_CHARS_TO_READ) == 0 && buffer[0] != '\0' && (sscanf(buffer, "%ld", &projected_count) != 1 || projected_count < 0))
+	{
+		fputs("Invalid number of employees, no projection will be made.\n", stderr);
+		projected_count = -1;
+	}
+
+	for(current_record = head; current_record != NULL; current_record = current_record->next)
+	{
+		record_strings = strlen(current_record->name) + 1 + strlen(current_record->job) + 1;
+		string_bytes += record_strings;
+		string_allocations += malloc_footprint(record_strings);
+		if(current_record->skip_levels > 1)
+		{
+			skip_pointers += current_record->skip_levels - 1;
+			skip_allocations += malloc_footprint((current_record->skip_levels - 1) * sizeof(employee *));
+		}
+	}
+
+	for(entry = query_cache; entry < query_cache + QUERY_CACHE_ENTRIES; entry++)
+		if(entry->in_use)
+			cache_bytes += malloc_footprint(entry->result_count * sizeof(employee *));
+
+	allocated_structures = employee_blocks * EMPLOYEES_PER_BLOCK;
+	overhead = employee_blocks * (malloc_footprint(EMPLOYEES_PER_BLOCK * sizeof(employee)) - EMPLOYEES_PER_BLOCK * sizeof(employee))
+						 + (allocated_structures - employee_count) * sizeof(employee) + string_allocations - string_bytes
+						 + skip_allocations - skip_pointers * sizeof(employee *);
+
+	printf("%-34s %14s %12s\n", "", "bytes", "per employee");
+	printf("%-34s %14d\n", "Employees", employee_count);
+	printf("%-34s %14lu\n", "Employee structure size", (unsigned long)sizeof(employee));
+	print_memory_line("Name and job strings", string_bytes, employee_count);
+	print_memory_line("Employee structures", (double)employee_count * sizeof(employee), employee_count);
+	print_memory_line("Skip list pointers", skip_pointers * sizeof(employee *), employee_count);
+	print_memory_line("Allocator overhead (estimated)", overhead, employee_count);
+	printf("%-34s %14lu\n", "  of which free employee structures", (allocated_structures - employee_count) * (unsigned long)sizeof(employee));
+
+	/* The indexes and views that don't grow with the number of employees (other than the query cache, which depends on the queries) */
+	fixed = sizeof(name_index) + sizeof(bloom_filter) + sizeof(skip_list_head) + sizeof(job_group_view) + job_group_view_count * malloc_footprint(sizeof(job_group))
+					+ sizeof(query_cache) + cache_bytes + sizeof(metrics) + trace_buffer_count * (malloc_footprint(sizeof(trace_buffer)) + malloc_footprint(TRACE_RING_SIZE * sizeof(trace_event)));
+	print_memory_line("Name index", sizeof(name_index), -1);
+	print_memory_line("Bloom filter", sizeof(bloom_filter), -1);
+	print_memory_line("Skip list heads", sizeof(skip_list_head), -1);
+	print_memory_line("Job groups", sizeof(job_group_view) + job_group_view_count * malloc_footprint(sizeof(job_group)), -1);
+	print_memory_line("Query cache", sizeof(query_cache) + cache_bytes, -1);
+	print_memory_line("Metrics and trace", sizeof(metrics) + trace_buffer_count * (malloc_footprint(sizeof(trace_buffer)) + malloc_footprint(TRACE_RING_SIZE * sizeof(trace_event))), -1);
+
+	per_employee = employee_count > 0 ? (employee_count * (double)sizeof(employee) + string_bytes + skip_pointers * sizeof(employee *) + overhead) / employee_count : 0;
+	print_memory_line("Total (estimated)", per_employee * employee_count + fixed, -1);
+
+	rss = resident_set_size();
+	if(rss >= 0)
+		print_memory_line("Resident set size", rss, -1);
+	else
+		printf("%-34s %14s\n", "Resident set size", "unknown");
+
+	if(projected_count >= 0)
+	{
+		/* With no employees to measure, assume full blocks, names and jobs half the maximum length,
+			 and that one employee in SKIP_LIST_CHANCE has skip list pointers (which nearly always fit in the smallest allocation) */
+		if(employee_count == 0)
+			per_employee = sizeof(employee) + malloc_footprint((MAX_NAME_LENGTH + MAX_JOB_LENGTH) / 2 + 2)
+										 + malloc_footprint(sizeof(employee *)) / (double)SKIP_LIST_CHANCE;
+		printf("\nProjected for %ld employees: %.0f bytes (%.1f MiB), at %.1f bytes per employee\n", projected_count,
+					 per_employee * projected_count + fixed, (per_employee * projected_count + fixed) / (1024.0 * 1024.0), per_employee);
+	}
+
+	return;
+}
+
+/*
+	Function: compare_sort_records()
+	Purpose: Compare two sort records for qsort(), so that they are sorted alphabetically by name,
+					 with employees with the same name kept in the order they were in the file.
+	Arguments: Pointers to the two sort records to compare (first and second).
+	Return value: < 0 if the first record belongs before the second, > 0 if it belongs after.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int compare_sort_records(const void *first, const void *second)
+{
+	const sort_record *first_record = (const sort_record *)first, *second_record = (const sort_record *)second;
+	int result = strcmp(first_record->name, second_record->name);
+
+	if(result != 0)
+		return result;
+	return (first_record->position > second_record->position) - (first_record->position < second_record->position);
+}
+
+/*
+	Function: write_sorted_run()
+	Purpose: Sort a run of employees and write them to a temporary file, in the database file format.
+	Arguments: The employees in the run (records).
+						 The number of employees in the run (count).
+	Return value: The temporary file, rewound ready to be read, or NULL if it couldn't be written.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static FILE *write_sorted_run(sort_record records[], long count)
+{
+	FILE *file_pointer = tmpfile();
+
+	if(file_pointer == NULL)
+		return NULL;
+	setvbuf(file_pointer, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
 
-	/* This for loop initially sets the first character of employee_input->job to '\0', meaning the string is empty.
-		 It then loops until sscanf(employee_input->job,"%1[^\n]", buffer) returns 1, meaning that the user has entered something.
-		 (Unless get_input_validity_check terminates the program, or read_string encounters EOF)
-		 A prompt is given to the user (if the input is from the user not from a file) each time the loop executes.
-		 An error message is given to the user each time invalid input is read. */
-	for(employee_input->job[0] = '\0', loop_count=0; sscanf(employee_input->job,"%1[^\n]", buffer) < 1; loop_count++)
+	write_sort_records(file_pointer, records, count);
+
+	if(fflush(file_pointer) != 0 || ferror(file_pointer))
 	{
-		get_input_validity_check(loop_count, from_file, JOB_IDENTIFIER);
-		if(read_string(fp, structure_member_prefix[from_file][JOB_IDENTIFIER], employee_input->job, MAX_JOB_LENGTH) == -1)
-			print_error(file_read_failure, DO_EXIT);
+		fclose(file_pointer);
+		return NULL;
 	}
 
-	/* Return the address of the employee structure containing the input */
-	return employee_input;
+	rewind(file_pointer);
+	return file_pointer;
 }
 
 /*
-	Function: print_single_employee()
-	Purpose: Output the details of a single employee record to a specified output stream
-	Arguments: The stream to print the details of the employee onto (fp)
-						 The address of the employee record to print (employee_to_print)
-	Return value: None.
+	Function: write_sort_records()
+	Purpose: Sort a run of employees and write them to a file, in the database file format.
+	Arguments: The file to write to (file_pointer).
+						 The employees in the run (records).
+						 The number of employees in the run (count).
+	Return value: None (the caller checks the file for errors).
 	Inputs from user: None.
-	Outputs to user: The employee that is printed.
+	Outputs to user: None.
  */
-static void print_single_employee(FILE *fp, const employee *employee_to_print)
+static void write_sort_records(FILE *file_pointer, sort_record records[], long count)
 {
-	fprintf(fp, "%s%s\n", structure_member_prefix[PREFIX_ON][NAME_IDENTIFIER], employee_to_print->name);
-	fprintf(fp, "%s%c\n", structure_member_prefix[PREFIX_ON][SEX_IDENTIFIER], employee_to_print->sex);
-	fprintf(fp, "%s%d\n", structure_member_prefix[PREFIX_ON][AGE_IDENTIFIER], employee_to_print->age);
-	fprintf(fp, "%s%s\n", structure_member_prefix[PREFIX_ON][JOB_IDENTIFIER], employee_to_print->job);
+	long i;
+
+	qsort(records, count, sizeof(sort_record), compare_sort_records);
+	for(i = 0; i < count; i++)
+		fprintf(file_pointer, "%s%s\n%s%c\n%s%d\n%s%s\n\n",
+						structure_member_prefix[PREFIX_ON][NAME_IDENTIFIER], records[i].name,
+						structure_member_prefix[PREFIX_ON][SEX_IDENTIFIER], records[i].sex,
+						structure_member_prefix[PREFIX_ON][AGE_IDENTIFIER], records[i].age,
+						structure_member_prefix[PREFIX_ON][JOB_IDENTIFIER], records[i].job);
+
 	return;
 }
 
 /*
-	Function: place_employee()
-	Purpose: Place an employee record into the correct place (i.e alphabetical order by name) in the linked list.
-	Arguments: The address of the employee to add to the linked list.
+	Function: close_sorted_runs()
+	Purpose: Close the temporary files holding sorted runs that haven't been merged (which deletes them), and free the array of runs,
+					 when sorting a database file is abandoned.
+	Arguments: The runs (runs), any of which may be NULL if it has already been closed, and the number of runs (run_count).
 	Return value: None.
 	Inputs from user: None.
-	Outputs to user: None, unless the "#define DEBUG_PLACE_EMPLOYEE" is uncommented at the top of the source code,
-									 in which case the function outputs debugging messages and information at each stage of the sorting process.
+	Outputs to user: None.
  */
-static void place_employee(employee *employee_to_place)
+static void close_sorted_runs(FILE *runs[], int run_count)
 {
-	/* Set temp_ptr (which we will use in the main part of place_employee to find the record that belongs directly before employee_to_place) to point at the head. */
-	employee *temp_ptr = head;
-	
-	#ifdef DEBUG_PLACE_EMPLOYEE
-	fprintf(stderr, "employee_to_place = %p, this points to:\n", employee_to_place);
-	employee_to_place == NULL? fputs("Nothing.", stderr): print_single_employee(stderr, employee_to_place);
-	#endif
-	
-	/* See if record belongs at the beginning of the list, if so make it the head */
-	if(head == NULL)
-	{
-		#ifdef DEBUG_PLACE_EMPLOYEE
-		fputs("The head is NULL, I am making this record the new head.\n\n", stderr);
-		#endif
-		
-		head = employee_to_place;
-		head->next = NULL;
-		head->prev = NULL;
-	/* See if the record belongs before the current head. If so, make it the new head */
-	/* If the strcmp is > 0, the first string belongs AFTER the second */
-	}else if(strcmp(head->name, employee_to_place->name) >= 0)
-	{
-		#ifdef DEBUG_PLACE_EMPLOYEE
-		fputs("This record belongs before (or is the same as) the current head.\n\n", stderr);
-		#endif
-		
-		head->prev = employee_to_place;
-		employee_to_place->next = head;
-		employee_to_place->prev = NULL;
-		head = employee_to_place;
-		
-	}else{
-		/* Otherwise the record must belong somewhere in the middle of the list */
-		#ifdef DEBUG_PLACE_EMPLOYEE
-		fputs("This record belongs somewhere after the head in the list.\n", stderr);
-		fprintf(stderr, "strcmp goes to: %d, temp_ptr->next = %p\n", strcmp(head->name, employee_to_place->name), head->next);
-		#endif
-		
-		/* This for loop finds the record directly before employee_to_place */
-		for(temp_ptr = head; 1 ; temp_ptr = temp_ptr->next )
-		{
-			#ifdef DEBUG_PLACE_EMPLOYEE
-			fprintf(stderr, "(internal to for loop)temp_ptr = %p, this points to:\n", temp_ptr);
-			temp_ptr == NULL? fputs("Nothing.\n", stderr): print_single_employee(stderr, temp_ptr);
-			#endif
-			
-			/* If this statement is true, then employee_to_place belongs one before temp_ptr */
-			if(strcmp(employee_to_place->name, temp_ptr->name) <= 0)
-			{
-				temp_ptr = temp_ptr->prev;
-				break;
-			}
+	int i;
 
-			/* If the current record pointed to by temp_ptr is at the end of the list, break and put the */
-			if(temp_ptr->next == NULL)
-				break;
+	for(i = 0; i < run_count; i++)
+		if(runs[i] != NULL)
+			fclose(runs[i]);
+	free(runs);
 
-		}
-		/* temp_ptr now points to the entry that belongs directly before employee to place */
-		
-		#ifdef DEBUG_PLACE_EMPLOYEE
-		printf("(after for loop, temp_ptr should now be directly before employee_to_place)temp_ptr = %p, this points to:\n", temp_ptr);
-		temp_ptr == NULL? fputs("Nothing.\n", stderr): print_single_employee(stderr, temp_ptr);
-		putchar('\n');
-		#endif
-		
-		employee_to_place->prev = temp_ptr;
-		employee_to_place->next = temp_ptr->next;
-		
-		/* We need to see if there is another record after temp_ptr, to avoid writing to NULL */
-		if(temp_ptr->next != NULL)
-			(temp_ptr->next)->prev = employee_to_place;
-		temp_ptr->next = employee_to_place;
-	}
 	return;
 }
 
 /*
-	Function: search_for_employee()
-	Purpose: Find the first employee in the linked list whose name matches a given string.
-	Arguments: A string containing the name of the employee to find (name_to_find).
-	Return value: A pointer to the employee structure whose name matches the given string.
-								A pointer to NULL will be returned if no employees match the given string.
+	Function: run_belongs_before()
+	Purpose: Decide whether the next employee from one sorted run belongs before the next employee from another, when merging the runs.
+					 Employees with the same name are taken from the run made first, which keeps them in the order they were in the file.
+	Arguments: The two runs to compare (first and second), which must both have a current employee.
+	Return value: 1 if the first run's employee belongs first.
+								0 if it doesn't.
 	Inputs from user: None.
-	Outputs to user: None, unless the "#define DEBUG_SEARCH_FOR_EMPLOYEE" line is uncommented at the top of the source code,
-									 in which case the function outputs debugging messages and information at each stage of the searching process.
+	Outputs to user: None.
  */
-static employee *search_for_employee(const char *name_to_find)
+static int run_belongs_before(const sorted_run *first, const sorted_run *second)
 {
-	/* Output structure */
-	employee *current_record;
+	int result = strcmp(first->current->name, second->current->name);
+	return result < 0 || (result == 0 && first->number < second->number);
+}
 
-	/* If the list is empty, return NULL */
-	if(head == NULL)
-		return NULL;
+/*
+	Function: sift_down_runs()
+	Purpose: Move a run down a heap of sorted runs until the run whose employee belongs first is at the top (as for sift_down()).
+	Arguments: The heap (heap), the number of runs in it (heap_size) and the position of the run to move down (i).
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void sift_down_runs(sorted_run *heap[], int heap_size, int i)
+{
+	sorted_run *temp_ptr;
+	int child;
 
-	/* Loop through the linked list, until an employee whose name matches name_to_find is found (or we reach the end of th list) */
-	for(current_record = head; current_record != NULL; current_record = current_record->next)
+	for(child = 2 * i + 1; child < heap_size; i = child, child = 2 * i + 1)
 	{
-		#ifdef DEBUG_SEARCH_FOR_EMPLOYEE
-		fprintf(stderr, "(internal)current_record = %p, this points to:\n", current_record);
-		current_record == NULL? fputs("Nothing.", stderr): print_single_employee(stderr, current_record);
-		#endif
-		
-		/* If the name is found, break */
-		if(strcmp(name_to_find, current_record->name) == 0)
-				break;
+		if(child + 1 < heap_size && run_belongs_before(heap[child + 1], heap[child]))
+			child++;
+		if(!run_belongs_before(heap[child], heap[i]))
+			break;
+
+		temp_ptr = heap[i];
+		heap[i] = heap[child];
+		heap[child] = temp_ptr;
 	}
-		#ifdef DEBUG_SEARCH_FOR_EMPLOYEE
-		fprintf(stderr, "current_record = %p, this points to:\n", current_record);
-		current_record == NULL? puts("Nothing.", stderr): print_single_employee(stderr, current_record);
-		#endif
-	
-	/* current_record will now either contain the address of the matching employee,
-			or NULL (since the next member of the last employee in the list is NULL) */
-	return current_record;
+
+	return;
 }
 
 /*
-	Function: delete_employee_from_list()
-	Purpose: Remove an employee from the linked list, rearranging the pointers of the surrounding employees so that the list remains intact.
-	Arguments: A pointer to the employee record to remove.
-	Return value: None.
+	Function: merge_sorted_runs()
+	Purpose: Merge sorted runs into a single sorted file, reading each run and writing the output sequentially.
+					 The run whose next employee belongs first is kept at the top of a heap, so each employee costs O(log k) comparisons for k runs.
+					 The runs are closed (which deletes the temporary files) and set to NULL once they have been merged.
+	Arguments: The temporary files holding the runs, in the order they were made (runs).
+						 The number of runs (run_count).
+						 The file to write the merged employees to (output).
+	Return value: 0 is returned if the runs were merged successfully.
+								-1 is returned if there was a problem allocating memory or writing the output.
 	Inputs from user: None.
-	Outputs to user: None, unless the "#define DEBUG_DELETE_EMPLOYEE" line is uncommented at the top of the source code,
-									 in which case the function will output information about the employee it is about to delete
+	Outputs to user: The fact that the program may terminate if a run can't be read.
  */
-static void delete_employee_from_list(employee *record_to_delete)
+static int merge_sorted_runs(FILE *runs[], int run_count, FILE *output)
 {
-	#ifdef DEBUG_DELETE_EMPLOYEE
-	printf("record_to_delete = %p\n record_to_delete->prev = %p\n record_to_delete->next = %p\n", record_to_delete, record_to_delete->prev, record_to_delete->next);
-	#endif
-	
-	/* We have to check if the previous and next employees exist before we attempt to write to them */
-	if(record_to_delete->prev != NULL)
-		(record_to_delete->prev)->next = record_to_delete->next;
-	if(record_to_delete->next != NULL)
-		(record_to_delete->next)->prev = record_to_delete->prev;
-	
-	/* If we're removing the head, we need to make the head point to the next record in the list */
-	if(record_to_delete	== head)
-		head = record_to_delete->next;
-		
-	/* Free the space used by the record that we're deleting */
-	free(record_to_delete);
-	
-	return;
+	sorted_run *merge_runs, **heap;
+	int heap_size = 0, i, result = 0;
+
+	merge_runs = (sorted_run *)malloc(run_count * sizeof(sorted_run));
+	heap = (sorted_run **)malloc(run_count * sizeof(sorted_run *));
+	if(merge_runs == NULL || heap == NULL)
+	{
+		free(merge_runs);
+		free(heap);
+		return -1;
+	}
+
+	for(i = 0; i < run_count; i++)
+	{
+		merge_runs[i].file_pointer = runs[i];
+		merge_runs[i].number = i;
+		merge_runs[i].current = get_input(runs[i], INPUT_FROM_FILE);
+		heap[heap_size++] = &merge_runs[i];
+	}
+	for(i = heap_size / 2 - 1; i >= 0; i--)
+		sift_down_runs(heap, heap_size, i);
+
+	while(heap_size > 0)
+	{
+		print_single_employee(output, heap[0]->current);
+		fputc('\n', output);
+
+		/* Replace the employee just written with the next one from the same run, or take the run off the heap if it is finished */
+		free_employee(heap[0]->current);
+		if(end_of_file_test(heap[0]->file_pointer))
+			heap[0]->current = get_input(heap[0]->file_pointer, INPUT_FROM_FILE);
+		else
+			heap[0] = heap[--heap_size];
+		sift_down_runs(heap, heap_size, 0);
+	}
+
+	if(ferror(output))
+		result = -1;
+
+	for(i = 0; i < run_count; i++)
+	{
+		fclose(runs[i]);
+		runs[i] = NULL;
+	}
+	free(merge_runs);
+	free(heap);
+	return result;
 }
 
 /*
-	Function: end_of_file_test()
-	Purpose: Get the input file into the correct position to read the next record, and check to see if the file contains any more records.
-	Arguments: A file pointer to the stream to manipulate (file_pointer).
-	Return value: 0 if there are no more records on the file.
-								1 if there are more records on the file.
+	Function: sort_database_file()
+	Purpose: Sort a database file into alphabetical order by name, writing the result to another file, without loading the database.
+					 This works for files much larger than the memory available: the file is read in runs that fit in the memory budget,
+					 each run is sorted and written to a temporary file, and then the runs are merged (see merge_sorted_runs()).
+					 If there are more runs than can be merged at once within the budget (each run being read needs a DATABASE_FILE_BUFFER_SIZE buffer),
+					 they are merged in groups into longer runs first. All the reading and writing is sequential.
+					 Employees with the same name stay in the order they were in the file.
+					 The sorted file can then be loaded quickly, as read_employee_databases() links each employee in after the previous one.
+	Arguments: The name of the database file to sort (input_file_name).
+						 The name of the sorted file to write (output_file_name).
+						 The memory budget in bytes (budget), for the employees in a run and the buffers used when merging.
+	Return value: 0 is returned if the file was sorted successfully.
+								-1 is returned if there was a problem (an error message having been printed).
 	Inputs from user: None.
-	Outputs to user: None, unless the "#define DEBUG_END_OF_FILE_TEST" line is uncommented at the top of the source code,
-									 in which case the function will output each character it tests, the corresponding ASCII value,
-									 and whether the function interprets that character as meaning that there is remaining records in the databae file.
+	Outputs to user: Relevant error messages (printed to stderr).
+									 The program may exit, if the database file is incorrectly formatted, or there is a problem allocating memory.
  */
-static int end_of_file_test(FILE *file_pointer)
+static int sort_database_file(const char *input_file_name, const char *output_file_name, unsigned long budget)
 {
-	/* Integer to store the character that will be input */
-	int c;
-	/* Get the next character from the stream */
-	c = fgetc(file_pointer);
-	
-	#ifdef DEBUG_END_OF_FILE_TEST
-	fprintf(stderr, "End of file test character is: %c\nThis is an ascii code of: %d \n", c, c);
-	#endif
-	
-	/* If the next character is NOT a \n, the database is incorrectly formatted */
-	if(c == '\n'){
-		/* If the character we got WAS a \n, try getting another to see if we're at the end of the file */
-		c = fgetc(file_pointer);
-		
-		#ifdef DEBUG_END_OF_FILE_TEST
-		fprintf(stderr, "Second end of file test character is: %c\nThis is an ascii code of: %d \n", c, c);
-		#endif
-		
-	}else
-		print_error("Database file is incorrectly formatted, the program will now exit.\n", DO_EXIT);
+	FILE *input, *output, **runs = NULL, **merged_runs;
+	sort_record *records;
+	char *strings;
+	employee *employee_input;
+	unsigned long strings_size, strings_used = 0, needed;
+	long record_space, count = 0, position = 0;
+	int run_count = 0, run_space = 0, fan_in, merged_count, i, c;
 
-	/* If we did reach the end of the file when we got the second character, then return 0 */
-	if(feof(file_pointer))
-		return 0;
-	/* Otherwise, "unget" the character (i.e put it back on the stream) and return 1 */
-	ungetc(c, file_pointer);
-	return 1;
+	input = fopen(input_file_name, "r");
+	if(input == NULL)
+	{
+		fputs("Error opening database file.\n", stderr);
+		return -1;
+	}
+	setvbuf(input, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	/* A quarter of the budget holds the sort records, and the rest holds their strings */
+	record_space = budget / 4 / sizeof(sort_record);
+	strings_size = budget - record_space * sizeof(sort_record);
+	records = (sort_record *)malloc(record_space * sizeof(sort_record));
+	strings = (char *)malloc(strings_size);
+	if(records == NULL || strings == NULL)
+		print_error("Problem allocating memory for sorting.\nThe program will now exit.\n", DO_EXIT);
+
+	/* Read the file a run at a time (an empty file has no runs) */
+	c = fgetc(input);
+	if(c != EOF)
+	{
+		ungetc(c, input);
+		do{
+			employee_input = get_input(input, INPUT_FROM_FILE);
+			needed = strlen(employee_input->name) + 1 + strlen(employee_input->job) + 1;
+
+			/* If this employee doesn't fit, the run is full, so sort it and write it out */
+			if(count == record_space || strings_used + needed > strings_size)
+			{
+				if(run_count == run_space)
+				{
+					run_space = run_space == 0 ? 16 : run_space * 2;
+					runs = (FILE **)realloc(runs, run_space * sizeof(FILE *));
+					if(runs == NULL)
+						print_error("Problem allocating memory for sorting.\nThe program will now exit.\n", DO_EXIT);
+				}
+				if((runs[run_count] = write_sorted_run(records, count)) == NULL)
+				{
+					fputs("Error writing a temporary file, the database file has not been sorted.\n", stderr);
+					free_employee(employee_input);
+					fclose(input);
+					free(records);
+					free(strings);
+					close_sorted_runs(runs, run_count);
+					return -1;
+				}
+				run_count++;
+				count = 0;
+				strings_used = 0;
+			}
+
+			records[count].name = strcpy(strings + strings_used, employee_input->name);
+			strings_used += strlen(employee_input->name) + 1;
+			records[count].job = strcpy(strings + strings_used, employee_input->job);
+			strings_used += strlen(employee_input->job) + 1;
+			records[count].age = employee_input->age;
+			records[count].sex = employee_input->sex;
+			records[count].position = position++;
+			count++;
+
+			free_employee(employee_input);
+		} while(end_of_file_test(input));
+	}
+	fclose(input);
+
+	output = fopen(output_file_name, "w");
+	if(output == NULL)
+	{
+		fputs("Error opening the sorted file.\n", stderr);
+		free(records);
+		free(strings);
+		close_sorted_runs(runs, run_count);
+		return -1;
+	}
+	setvbuf(output, NULL, _IOFBF, DATABASE_FILE_BUFFER_SIZE);
+
+	/* If everything fitted in one run, it can be written straight out. Otherwise the last run is written out like the others, and they are merged */
+	if(run_count == 0)
+	{
+		write_sort_records(output, records, count);
+		free(records);
+		free(strings);
+	}else{
+		if(run_count == run_space)
+		{
+			runs = (FILE **)realloc(runs, (run_space + 1) * sizeof(FILE *));
+			if(runs == NULL)
+				print_error("Problem allocating memory for sorting.\nThe program will now exit.\n", DO_EXIT);
+		}
+		if((runs[run_count] = write_sorted_run(records, count)) == NULL)
+		{
+			fputs("Error writing a temporary file, the database file has not been sorted.\n", stderr);
+			fclose(output);
+			free(records);
+			free(strings);
+			close_sorted_runs(runs, run_count);
+			return -1;
+		}
+		run_count++;
+
+		/* The run buffers aren't needed while merging, which leaves the budget for the file buffers */
+		free(records);
+		free(strings);
+		fan_in = budget / DATABASE_FILE_BUFFER_SIZE - 1;
+		if(fan_in < 2)
+			fan_in = 2;
+
+		/* Merge groups of runs into longer runs until there are few enough to merge at once */
+		while(run_count > fan_in)
+		{
+			merged_runs = (FILE **)malloc(((run_count + fan_in - 1) / fan_in) * sizeof(FILE *));
+			if(merged_runs == NULL)
+				print_error("Problem allocating memory for sorting.\nThe program will now exit.\n", DO_EXIT);
+
+			for(i = 0, merged_count = 0; i < run_count; i += fan_in, merged_count++)
+			{
+				merged_runs[merged_count] = tmpfile();
+				if(merged_runs[merged_count] == NULL ||
+					 merge_sorted_runs(runs + i, run_count - i < fan_in ? run_count - i : fan_in, merged_runs[merged_count]) != 0 ||
+					 fflush(merged_runs[merged_count]) != 0)
+				{
+					/* The runs that have been merged are already closed, and set to NULL */
+					fputs("Error writing a temporary file, the database file has not been sorted.\n", stderr);
+					fclose(output);
+					close_sorted_runs(runs, run_count);
+					close_sorted_runs(merged_runs, merged_count + 1);
+					return -1;
+				}
+				rewind(merged_runs[merged_count]);
+			}
+
+			free(runs);
+			runs = merged_runs;
+			run_count = merged_count;
+		}
+
+		if(merge_sorted_runs(runs, run_count, output) != 0)
+		{
+			fputs("Error writing the sorted file.\n", stderr);
+			fclose(output);
+			close_sorted_runs(runs, run_count);
+			return -1;
+		}
+	}
+
+	free(runs);
+	if(fclose(output) != 0)
+	{
+		fputs("Error writing the sorted file.\n", stderr);
+		return -1;
+	}
+
+	return 0;
 }
 
 /*
-	Function: menu_add_employee()
-	Purpose: A function,designed to be called from the menu system, that prompts the user to enter the details of a new employee.
-					 It then places that employee in the correct place (alphabetical order by name field) in the linked list.
-	Arguments: None.
+	Function: hand_over_import_chunk()
+	Purpose: Hand a chunk of employees that have been read for an import to the thread sorting them (see import_sort_worker()).
+	Arguments: The import sorter (sorter).
+						 The chunk (chunk), which mustn't be changed after it has been handed over, and the number of employees in it (length).
+						 Whether this is the last chunk (finished).
 	Return value: None.
-	Inputs from user: The details of new employee.
-	Outputs to user: Prompts for information and error messages (written to stderr).
-									 This function may cause the program to close if there is a memory allocation error when allocating space for the new employee.
-									 Additionally, debugging messages may be printed to stderr, if the relevant #define lines are uncommented at the top of the source code.
+	Inputs from user: None.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
  */
-static void menu_add_employee(void)
+static void hand_over_import_chunk(import_sorter *sorter, ranked_employee *chunk, int length, int finished)
 {
-	employee *employee_to_add_ptr;
+	pthread_mutex_lock(&sorter->lock);
 
-	employee_to_add_ptr = get_input(stdin, INPUT_FROM_USER);
+	/* Make more room if needed, doubling the space each time (the sorting thread only looks at chunks while holding the lock) */
+	if(sorter->chunk_count == sorter->chunk_space)
+	{
+		sorter->chunk_space = sorter->chunk_space == 0 ? 16 : sorter->chunk_space * 2;
+		sorter->chunks = (ranked_employee **)realloc(sorter->chunks, sorter->chunk_space * sizeof(ranked_employee *));
+		if(sorter->chunks == NULL)
+			print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
+	}
+	sorter->chunks[sorter->chunk_count++] = chunk;
 
-	place_employee(employee_to_add_ptr);
+	if(finished)
+	{
+		sorter->last_chunk_length = length;
+		sorter->finished = 1;
+	}
 
+	pthread_cond_signal(&sorter->changed);
+	pthread_mutex_unlock(&sorter->lock);
 	return;
 }
 
 /*
-	Function: menu_print_database()
-	Purpose: A function, designed to be called from the menu system, that prints all the employees in the database to stdout.
-					 The employees are printed in alphabetical order, and with prefixes for each field (e.g. Name).
-	Arguments: None.
-	Return value: None.
+	Function: import_sort_worker()
+	Purpose: The function run by the thread sorting an import, which sorts each chunk with compare_batch_employees() as it is handed over,
+					 until the last chunk has been sorted.
+	Arguments: A pointer to the import sorter (sorter).
+	Return value: NULL.
 	Inputs from user: None.
-	Outputs to user: The details of all the employees in the database, writted to stdout.
-									 Additionally, debugging messages may be printed to stderr, if the relevant #define lines are uncommented at the top of the source code.
+	Outputs to user: None (any tracepoint it reaches records into the thread's own ring buffer, see trace_event_add()).
  */
-static void menu_print_database(void)
+static void *import_sort_worker(void *sorter)
 {
-	employee *employee_to_print;
+	import_sorter *shared_sorter = (import_sorter *)sorter;
+	ranked_employee *chunk;
+	int length;
 
-	for(employee_to_print = head; employee_to_print != NULL; employee_to_print = employee_to_print->next)
+	for(;;)
 	{
-		print_single_employee(stdout, employee_to_print);
-		putchar('\n');
+		pthread_mutex_lock(&shared_sorter->lock);
+		while(shared_sorter->sorted_count == shared_sorter->chunk_count && !shared_sorter->finished)
+			pthread_cond_wait(&shared_sorter->changed, &shared_sorter->lock);
+		if(shared_sorter->sorted_count == shared_sorter->chunk_count)
+		{
+			pthread_mutex_unlock(&shared_sorter->lock);
+			return NULL;
+		}
+		chunk = shared_sorter->chunks[shared_sorter->sorted_count];
+		length = import_chunk_length(shared_sorter, shared_sorter->sorted_count);
+		pthread_mutex_unlock(&shared_sorter->lock);
+
+		qsort(chunk, length, sizeof(ranked_employee), compare_batch_employees);
+
+		pthread_mutex_lock(&shared_sorter->lock);
+		shared_sorter->sorted_count++;
+		pthread_mutex_unlock(&shared_sorter->lock);
 	}
-	return;
-}	    
+}
 
 /*
-	Function: menu_delete_employee()
-	Purpose: A function, designed to be called from the menu system, that deletes all the employees with a given name in the database.
-	Arguments: None.
+	Function: import_chunk_length()
+	Purpose: Find the number of employees in a chunk that has been handed over for sorting.
+	Arguments: The import sorter (sorter), whose lock must be held if the chunks are still being handed over.
+						 The number of the chunk (chunk).
+	Return value: The number of employees in the chunk.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static int import_chunk_length(const import_sorter *sorter, int chunk)
+{
+	return sorter->finished && chunk == sorter->chunk_count - 1 ? sorter->last_chunk_length : IMPORT_CHUNK_SIZE;
+}
+
+/*
+	Function: sift_down_chunks()
+	Purpose: Move a chunk down a heap of sorted chunks until the chunk whose next employee belongs first is at the top (as for sift_down()).
+	Arguments: The import sorter (sorter).
+						 The position of the next employee to take from each chunk (positions).
+						 The heap of chunk numbers (heap), the number of chunks in it (heap_size) and the position of the chunk to move down (i).
 	Return value: None.
 	Inputs from user: None.
-	Outputs to user: The name of the employee(s) to delete
-									 Debugging messages may be printed to stderr, if the relevant #define lines are uncommented at the top of the source code.
+	Outputs to user: None.
  */
-static void menu_delete_employee(void)
+static void sift_down_chunks(const import_sorter *sorter, const int positions[], int heap[], int heap_size, int i)
 {
-	/* Declare a string containing the name of the employee to delete, and a pointer to the employee to delete */
-	char employee_name_to_delete[MAX_NAME_LENGTH + 1];
-	employee *employee_to_delete;
-	
-	/* Prompt the user to enter the name of the employee(s) they would like to delete */
-	fputs("Please enter the name of the employee to be deleted: ", stderr);
-	read_line(stdin, employee_name_to_delete, MAX_NAME_LENGTH);
-	
-	/* Search for the employee to delete */
-	employee_to_delete = search_for_employee(employee_name_to_delete);
+	int child, temp;
 
-	if(employee_to_delete == NULL)
+	for(child = 2 * i + 1; child < heap_size; i = child, child = 2 * i + 1)
 	{
-		fputs("Employee not found.\n", stderr);
-		return;
-	}
-
-	delete_employee_from_list(employee_to_delete);
+		if(child + 1 < heap_size && compare_batch_employees(&sorter->chunks[heap[child + 1]][positions[heap[child + 1]]],
+																												&sorter->chunks[heap[child]][positions[heap[child]]]) < 0)
+			child++;
+		if(compare_batch_employees(&sorter->chunks[heap[child]][positions[heap[child]]], &sorter->chunks[heap[i]][positions[heap[i]]]) >= 0)
+			break;
 
-	/* This loop keeps removing employees whose name match the string specified, until no employees remain whose name match the string specified. */
-	for(employee_to_delete = search_for_employee(employee_name_to_delete); employee_to_delete != NULL; employee_to_delete = search_for_employee(employee_name_to_delete))
-		delete_employee_from_list(employee_to_delete);
+		temp = heap[i];
+		heap[i] = heap[child];
+		heap[child] = temp;
+	}
 
 	return;
 }
 
 /*
-	Function: read_employee_database()
-	Purpose: A function, which is run upon starting the program (if a database file is specified in the program arguments),
-					 that loads the employees from a formatted database file into the database.
-	Arguments: The name of the database file to load (file_name).
-	Return value: None.
+	Function: merge_import_chunks()
+	Purpose: Merge the sorted chunks of an import into a single array sorted by compare_batch_employees().
+					 The chunk whose next employee belongs first is kept at the top of a heap, so each employee costs O(log k) comparisons for k chunks.
+					 The chunks are freed (a single chunk is returned as it is).
+	Arguments: The import sorter (sorter), whose chunks have all been sorted.
+						 The number of employees in all the chunks (count).
+	Return value: A pointer to the merged array (which must be freed by the caller).
 	Inputs from user: None.
-	Outputs to user: Relevant error messages (printed to stderr)
-									 The program may exit, if there is a problem with the database file (i.e file not found, or incorrect formatting.
-									 Debugging messages may be printed to stderr, if the relevant #define lines are uncommented at the top of the source code.
+	Outputs to user: The fact that the program may terminate if there is a problem allocating memory.
  */
-static void read_employee_database(const char *file_name)
+static ranked_employee *merge_import_chunks(import_sorter *sorter, int count)
 {
-	/* File pointer for the database file */
-	FILE *file_pointer;
+	ranked_employee *batch;
+	int *positions, *heap, heap_size = 0, i;
 
-	/* Attempt to open the file specified by the user */
-	file_pointer = fopen(file_name, "r");
+	if(sorter->chunk_count == 1)
+	{
+		batch = sorter->chunks[0];
+		free(sorter->chunks);
+		return batch;
+	}
 
-	/* If the file pointer is NULL, the file couldn't be opened. */
-	if(file_pointer == NULL)
-		print_error("Error opening database file.\nThe program will now exit.\n", DO_EXIT);
+	batch = (ranked_employee *)malloc(count * sizeof(ranked_employee));
+	positions = (int *)malloc(sorter->chunk_count * sizeof(int));
+	heap = (int *)malloc(sorter->chunk_count * sizeof(int));
+	if(batch == NULL || positions == NULL || heap == NULL)
+		print_error("Problem allocating memory for another employee.\nThe program will now exit.\n", DO_EXIT);
+
+	for(i = 0; i < sorter->chunk_count; i++)
+	{
+		positions[i] = 0;
+		heap[heap_size++] = i;
+	}
+	for(i = heap_size / 2 - 1; i >= 0; i--)
+		sift_down_chunks(sorter, positions, heap, heap_size, i);
 
-	/* Pointer to employee structure for storing the address of the employee records as they are read from the file. */
-	employee *current_employee_ptr;
+	for(i = 0; i < count; i++)
+	{
+		batch[i] = sorter->chunks[heap[0]][positions[heap[0]]++];
 
-	/* Loop through the file, reading each employee into an employee structure and sorting it into the linked list.
-		 Stop when the end of the file is reached. */
-	do{
-		current_employee_ptr = get_input(file_pointer, INPUT_FROM_FILE);
-		place_employee(current_employee_ptr);
-	} while(end_of_file_test(file_pointer));
+		/* Take the chunk off the heap if it is finished */
+		if(positions[heap[0]] == import_chunk_length(sorter, heap[0]))
+			heap[0] = heap[--heap_size];
+		sift_down_chunks(sorter, positions, heap, heap_size, 0);
+	}
 
-	/* Close the file */
-	fclose(file_pointer);
+	for(i = 0; i < sorter->chunk_count; i++)
+		free(sorter->chunks[i]);
+	free(sorter->chunks);
+	free(positions);
+	free(heap);
+	return batch;
+}
+
+/*
+	Function: free_import_chunks()
+	Purpose: Free every chunk handed over for sorting, and the employees in them, when an import is abandoned.
+	Arguments: The import sorter (sorter), whose chunks have all been handed over and sorted.
+	Return value: None.
+	Inputs from user: None.
+	Outputs to user: None.
+ */
+static void free_import_chunks(import_sorter *sorter)
+{
+	int i, j;
+
+	for(i = 0; i < sorter->chunk_count; i++)
+	{
+		for(j = 0; j < import_chunk_length(sorter, i); j++)
+			free_employee(sorter->chunks[i][j].record);
+		free(sorter->chunks[i]);
+	}
+	free(sorter->chunks);
 
 	return;
 }
-